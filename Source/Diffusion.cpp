@@ -102,11 +102,7 @@ Diffusion::Diffusion (Amr*               Parent,
         ppdiff.query("max_order",           max_order);
         ppdiff.query("tensor_max_order",    tensor_max_order);
 
-        ppdiff.query("agglomeration", agglomeration);
-        ppdiff.query("consolidation", consolidation);
-        ppdiff.query("max_iter"    , max_iter);
-        ppdiff.query("max_fmg_iter", max_fmg_iter);
-        ppdiff.query("bottom_verbose", bottom_verbose);
+        read_mg_params();
 #ifdef AMREX_USE_HYPRE
         ppdiff.query("use_hypre", use_hypre);
         ppdiff.query("hypre_verbose", hypre_verbose);
@@ -145,6 +141,21 @@ Diffusion::Diffusion (Amr*               Parent,
     }
 }
 
+//
+// Multigrid options; also called again after solver autotuning.
+//
+void
+Diffusion::read_mg_params ()
+{
+    ParmParse ppdiff("diffuse");
+
+    ppdiff.query("agglomeration", agglomeration);
+    ppdiff.query("consolidation", consolidation);
+    ppdiff.query("max_iter"    , max_iter);
+    ppdiff.query("max_fmg_iter", max_fmg_iter);
+    ppdiff.query("bottom_verbose", bottom_verbose);
+}
+
 FluxRegister*
 Diffusion::viscFluxReg ()
 {
@@ -739,7 +750,7 @@ Diffusion::diffuse_tensor_velocity (Real                   dt,
                                  AMREX_SPACEDIM);
              tensorop.setCoarseFineBC(&crsedata, crse_ratio[0]);
            }
-           AmrLevel::FillPatch(*navier_stokes,Soln,soln_ng,prev_time,State_Type,Xvel,AMREX_SPACEDIM);
+           navier_stokes->FillPatchState(Soln,soln_ng,prev_time,Xvel,AMREX_SPACEDIM);
            tensorop.setLevelBC(0, &Soln);
          }
 
@@ -1608,7 +1619,7 @@ Diffusion::getViscTerms (MultiFab&              visc_terms,
             mlabec.setCoarseFineBC(&crsedata, crse_ratio[0]);
           }
 
-          AmrLevel::FillPatch(*navier_stokes,s_tmp,ng,time,State_Type,comp,1);
+          navier_stokes->FillPatchState(s_tmp,ng,time,comp,1);
           if (rho_flag == 2) {
             const MultiFab& rhotime = navier_stokes->get_rho(time);
             MultiFab::Divide(s_tmp,rhotime,0,0,1,ng);
@@ -1731,7 +1742,7 @@ Diffusion::getTensorViscTerms (MultiFab&              visc_terms,
                                     AMREX_SPACEDIM);
                 tensorop.setCoarseFineBC(&crsedata, crse_ratio[0]);
               }
-              AmrLevel::FillPatch(*navier_stokes,s_tmp,ng,time,State_Type,Xvel,AMREX_SPACEDIM);
+              navier_stokes->FillPatchState(s_tmp,ng,time,Xvel,AMREX_SPACEDIM);
               tensorop.setLevelBC(0, &s_tmp);
            }
 
@@ -1796,7 +1807,7 @@ Diffusion::FillBoundary (BndryRegister& bdry,
                navier_stokes->DistributionMap(),
                num_comp,nGrow,MFInfo(),navier_stokes->Factory());
 
-    AmrLevel::FillPatch(*navier_stokes,S,nGrow,time,State_Type,state_ind,num_comp);
+    navier_stokes->FillPatchState(S,nGrow,time,state_ind,num_comp);
 
     if (rho_flag == 2) {
         for (int n = 0; n < num_comp; ++n) {
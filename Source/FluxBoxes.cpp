@@ -1,4 +1,5 @@
 #include <FluxBoxes.H>
+#include <NavierStokesBase.H>
 
 using namespace amrex;
 
@@ -7,11 +8,25 @@ FluxBoxes::define (const AmrLevel* amr_level, int nvar, int nghost)
 {
     AMREX_ASSERT(data == nullptr);
     data = new MultiFab*[AMREX_SPACEDIM];
+
+    //
+    // Take the buffers from the level's workspace pool when there is one.
+    //
+    const auto* ns = dynamic_cast<const NavierStokesBase*>(amr_level);
+    pool = ns ? &ns->getWorkspace() : nullptr;
+
     for (int dir = 0; dir < AMREX_SPACEDIM; dir++)
     {
-        const BoxArray& ba = amr_level->getEdgeBoxArray(dir);
-        const DistributionMapping& dm = amr_level->DistributionMap();
-        data[dir] = new MultiFab(ba,dm,nvar,nghost,MFInfo(),amr_level->Factory());
+        if (pool)
+        {
+            data[dir] = pool->acquire(dir, nvar, nghost);
+        }
+        else
+        {
+            const BoxArray& ba = amr_level->getEdgeBoxArray(dir);
+            const DistributionMapping& dm = amr_level->DistributionMap();
+            data[dir] = new MultiFab(ba,dm,nvar,nghost,MFInfo(),amr_level->Factory());
+        }
     }
     return data;
 }
@@ -22,9 +37,14 @@ FluxBoxes::clear ()
     if (data != nullptr)
     {
         for (int i = 0; i<AMREX_SPACEDIM; i++) {
-            delete data[i];
+            if (pool) {
+                pool->release(data[i]);
+            } else {
+                delete data[i];
+            }
         }
         delete [] data;
         data = nullptr;
+        pool = nullptr;
     }
 }
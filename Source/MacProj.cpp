@@ -1,6 +1,11 @@
 
 #include <AMReX_Geometry.H>
 #include <AMReX_ParmParse.H>
+#ifndef AMREX_USE_EB
+#include <AMReX_MLABecLaplacian.H>
+#include <AMReX_MLMG.H>
+#include <AMReX_MultiFabUtil.H>
+#endif
 #include <MacProj.H>
 #include <NavierStokesBase.H>
 #include <OutFlowBC.H>
@@ -31,10 +36,45 @@ int  MacProj::max_order = 4;
 int  MacProj::agglomeration = 1;
 int  MacProj::consolidation = 1;
 int  MacProj::max_fmg_iter = -1;
+int  MacProj::mixed_precision = 0;
+Real MacProj::inner_tol = 1.e-4;
+int  MacProj::max_refine_iter = 10;
 
 namespace
 {
     Real umac_periodic_test_Tol;
+
+#ifndef AMREX_USE_EB
+    //
+    // dst = src, converted to the precision of dst, on the valid cells.
+    //
+    template <typename DST, typename SRC>
+    void copy_convert (DST& dst, const SRC& src)
+    {
+        using T = typename DST::value_type;
+        auto const& d = dst.arrays();
+        auto const& s = src.const_arrays();
+        amrex::ParallelFor(dst, [=] AMREX_GPU_DEVICE (int b, int i, int j, int k) noexcept
+        {
+            d[b](i,j,k) = static_cast<T>(s[b](i,j,k));
+        });
+        Gpu::streamSynchronize();
+    }
+
+    //
+    // dst += src, with src in single precision, on the valid cells.
+    //
+    void add_convert (MultiFab& dst, const fMultiFab& src)
+    {
+        auto const& d = dst.arrays();
+        auto const& s = src.const_arrays();
+        amrex::ParallelFor(dst, [=] AMREX_GPU_DEVICE (int b, int i, int j, int k) noexcept
+        {
+            d[b](i,j,k) += static_cast<Real>(s[b](i,j,k));
+        });
+        Gpu::streamSynchronize();
+    }
+#endif
 }
 
 void
@@ -69,10 +109,15 @@ MacProj::Initialize ()
     pp.query("check_umac_periodicity", check_umac_periodicity);
     pp.query("umac_periodic_test_Tol", umac_periodic_test_Tol);
 
-    pp.query("agglomeration", agglomeration);
-    pp.query("consolidation", consolidation);
-    pp.query("max_fmg_iter", max_fmg_iter);
-    pp.query( "maxorder"      , max_order );
+    read_mg_params();
+    pp.query("mixed_precision", mixed_precision);
+    pp.query("inner_tol",       inner_tol);
+    pp.query("max_refine_iter", max_refine_iter);
+#ifdef AMREX_USE_EB
+    if (mixed_precision) {
+        amrex::Abort("mac_proj.mixed_precision is not supported with EB");
+    }
+#endif
 #ifdef AMREX_USE_HYPRE
     if ( pp.contains("use_hypre") )
       amrex::Abort("use_hypre is no more. To use Hypre set mac_proj.bottom_solver = hypre.");
@@ -100,6 +145,20 @@ MacProj::Initialize ()
     initialized = true;
 }
 
+//
+// Multigrid options; also called again after solver autotuning.
+//
+void
+MacProj::read_mg_params ()
+{
+    ParmParse pp("mac_proj");
+
+    pp.query("agglomeration", agglomeration);
+    pp.query("consolidation", consolidation);
+    pp.query("max_fmg_iter", max_fmg_iter);
+    pp.query( "maxorder"      , max_order );
+}
+
 void
 MacProj::Finalize ()
 {
@@ -1139,6 +1198,20 @@ MacProj::mlmg_mac_solve (Amr* a_parent, const MultiFab* cphi, const BCRec& a_phy
     info.setAgglomeration(agglomeration);
     info.setConsolidation(consolidation);
 
+    std::array<MLLinOp::BCType,AMREX_SPACEDIM> mlmg_lobc;
+    std::array<MLLinOp::BCType,AMREX_SPACEDIM> mlmg_hibc;
+    set_mac_solve_bc(mlmg_lobc, mlmg_hibc, a_phys_bc, geom);
+
+#ifndef AMREX_USE_EB
+    if (mixed_precision)
+    {
+        mlmg_mac_solve_mixed(a_parent, cphi, level, info, mlmg_lobc, mlmg_hibc,
+                             a_mac_tol, a_mac_abs_tol, GetArrOfConstPtrs(bcoefs),
+                             Rhs, u_mac, mac_phi, fluxes);
+        return;
+    }
+#endif
+
     //
     // To use phi on CellCentroids, must also call
     // macproj.get_linop().setEBDirichlet (int amrlev, const MultiFab& phi, const MultiFab& beta)
@@ -1156,10 +1229,6 @@ MacProj::mlmg_mac_solve (Amr* a_parent, const MultiFab* cphi, const BCRec& a_phy
     //
     // Set BCs
     //
-    std::array<MLLinOp::BCType,AMREX_SPACEDIM> mlmg_lobc;
-    std::array<MLLinOp::BCType,AMREX_SPACEDIM> mlmg_hibc;
-    set_mac_solve_bc(mlmg_lobc, mlmg_hibc, a_phys_bc, geom);
-
     macproj.setDomainBC(mlmg_lobc, mlmg_hibc);
     if (level > 0 && cphi)
     {
@@ -1183,6 +1252,172 @@ MacProj::mlmg_mac_solve (Amr* a_parent, const MultiFab* cphi, const BCRec& a_phy
       macproj.getFluxes({fluxes}, {mac_phi}, MLMG::Location::FaceCentroid);
 }
 
+#ifndef AMREX_USE_EB
+//
+// Iterative refinement: the residual of the MAC system, phi and the
+// fluxes are computed in double precision, while each correction is
+// solved for in single precision, to inner_tol, with homogeneous boundary
+// data. The smoothing, which is bound by memory bandwidth, thus moves
+// half the bytes, and the passes stop when mac_tol (relative to the
+// first residual) or mac_abs_tol is met.
+//
+void
+MacProj::mlmg_mac_solve_mixed (Amr* a_parent, const MultiFab* cphi, int level,
+                               const LPInfo& info,
+                               const Array<MLLinOp::BCType,AMREX_SPACEDIM>& mlmg_lobc,
+                               const Array<MLLinOp::BCType,AMREX_SPACEDIM>& mlmg_hibc,
+                               Real a_mac_tol, Real a_mac_abs_tol,
+                               const Array<MultiFab const*,AMREX_SPACEDIM>& bcoefs,
+                               const MultiFab &Rhs,
+                               Array<MultiFab*,AMREX_SPACEDIM>& u_mac, MultiFab *mac_phi,
+                               Array<MultiFab*,AMREX_SPACEDIM>& fluxes)
+{
+    BL_PROFILE("MacProj::mlmg_mac_solve_mixed()");
+
+    const Geometry& geom = a_parent->Geom(level);
+    const BoxArray& ba = Rhs.boxArray();
+    const DistributionMapping& dm = Rhs.DistributionMap();
+    const int crse_ratio = (level > 0) ? a_parent->refRatio(level-1)[0] : 1;
+
+    //
+    // Double precision operator, with the boundary data of phi.
+    //
+    MLABecLaplacian linop({geom}, {ba}, {dm}, info);
+    linop.setMaxOrder(max_order);
+    linop.setDomainBC(mlmg_lobc, mlmg_hibc);
+    if (level > 0 && cphi) {
+        linop.setCoarseFineBC(cphi, crse_ratio);
+    }
+    linop.setLevelBC(0, mac_phi);
+    linop.setScalars(0.0, 1.0);
+    linop.setBCoeffs(0, bcoefs);
+    MLMG mlmg(linop);
+
+    //
+    // Single precision operator for the corrections, with homogeneous
+    // boundary data.
+    //
+    Array<fMultiFab,AMREX_SPACEDIM> fbcoefs;
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
+    {
+        fbcoefs[idim].define(bcoefs[idim]->boxArray(), dm, 1, 0);
+        copy_convert(fbcoefs[idim], *bcoefs[idim]);
+    }
+
+    MLABecLaplacianT<fMultiFab> flinop({geom}, {ba}, {dm}, info);
+    flinop.setMaxOrder(max_order);
+    flinop.setDomainBC(mlmg_lobc, mlmg_hibc);
+    std::unique_ptr<fMultiFab> fcphi;
+    if (level > 0 && cphi)
+    {
+        fcphi = std::make_unique<fMultiFab>(cphi->boxArray(), cphi->DistributionMap(),
+                                            1, cphi->nGrow());
+        fcphi->setVal(0.0f);
+        flinop.setCoarseFineBC(fcphi.get(), crse_ratio);
+    }
+    flinop.setLevelBC(0, nullptr);
+    flinop.setScalars(0.0f, 1.0f);
+    flinop.setBCoeffs(0, GetArrOfConstPtrs(fbcoefs));
+
+    MLMGT<fMultiFab> fmlmg(flinop);
+    {
+        ParmParse pp("mac_proj");
+        int maxiter = 200;
+        pp.query("maxiter", maxiter);
+        fmlmg.setMaxIter(maxiter);
+        fmlmg.setVerbose(verbose > 1 ? verbose : 0);
+
+        std::string bottom_solver("bicgcg");
+        pp.query("bottom_solver", bottom_solver);
+        if (bottom_solver == "bicgstab") {
+            fmlmg.setBottomSolver(MLMG::BottomSolver::bicgstab);
+        } else if (bottom_solver == "cg") {
+            fmlmg.setBottomSolver(MLMG::BottomSolver::cg);
+        } else if (bottom_solver == "cgbicg") {
+            fmlmg.setBottomSolver(MLMG::BottomSolver::cgbicg);
+        } else if (bottom_solver == "smoother") {
+            fmlmg.setBottomSolver(MLMG::BottomSolver::smoother);
+        } else {
+            // hypre has no single precision interface.
+            fmlmg.setBottomSolver(MLMG::BottomSolver::bicgcg);
+        }
+    }
+
+    //
+    // rhs = Rhs - div(u_mac), as in Hydro::MacProjector.
+    //
+    MultiFab rhs(ba, dm, 1, 0);
+    computeDivergence(rhs, GetArrOfConstPtrs(u_mac), geom);
+    rhs.mult(-1.0);
+    MultiFab::Add(rhs, Rhs, 0, 0, 1, 0);
+    //
+    // Without Dirichlet boundaries the system is singular; its residual can
+    // only reach the target if rhs has no mean, which MLMG otherwise removes.
+    //
+    bool singular = (level == 0);
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim) {
+        singular = singular && mlmg_lobc[idim] != MLLinOp::BCType::Dirichlet
+                            && mlmg_hibc[idim] != MLLinOp::BCType::Dirichlet;
+    }
+    if (singular) {
+        rhs.plus(-rhs.sum(0)/Real(ba.numPts()), 0, 1, 0);
+    }
+
+    MultiFab  res (ba, dm, 1, 0);
+    fMultiFab fres(ba, dm, 1, 0);
+    fMultiFab fcor(ba, dm, 1, 1);
+
+    Real resid  = 0.0;
+    Real target = 0.0;
+    int  pass   = 0;
+    for ( ; ; ++pass)
+    {
+        mlmg.compResidual({&res}, {mac_phi}, {&rhs});
+        resid = res.norminf();
+        if (pass == 0) {
+            target = std::max(a_mac_tol*resid, a_mac_abs_tol);
+        }
+        if (resid <= target || pass == max_refine_iter) break;
+
+        copy_convert(fres, res);
+        fcor.setVal(0.0f);
+        fmlmg.solve({&fcor}, {&fres}, static_cast<float>(inner_tol), 0.0f);
+        add_convert(*mac_phi, fcor);
+    }
+
+    if (verbose)
+    {
+        amrex::Print() << "MacProj::mlmg_mac_solve_mixed(): " << pass
+                       << " single precision pass(es), residual " << resid
+                       << " (target " << target << ")\n";
+    }
+    if (resid > target)
+    {
+        amrex::Abort("MacProj::mlmg_mac_solve_mixed(): mac_tol not met after "
+                     "mac_proj.max_refine_iter passes");
+    }
+
+    //
+    // fluxes = -B grad phi, which makes u_mac satisfy the constraint.
+    //
+    Array<MultiFab,AMREX_SPACEDIM> flux_tmp;
+    Array<MultiFab*,AMREX_SPACEDIM> flux = fluxes;
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
+    {
+        if (!fluxes[0])
+        {
+            flux_tmp[idim].define(u_mac[idim]->boxArray(), dm, 1, 0);
+            flux[idim] = &flux_tmp[idim];
+        }
+    }
+    mlmg.getFluxes({flux}, {mac_phi});
+
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim) {
+        MultiFab::Add(*u_mac[idim], *flux[idim], 0, 0, 1, 0);
+    }
+}
+#endif
+
 void
 MacProj::set_mac_solve_bc (Array<MLLinOp::BCType,AMREX_SPACEDIM>& mlmg_lobc,
                Array<MLLinOp::BCType,AMREX_SPACEDIM>& mlmg_hibc,
@@ -0,0 +1,391 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_MultiFabUtil.H>
+#include <AMReX_MLMG.H>
+#ifdef AMREX_USE_EB
+#include <AMReX_MLEBABecLap.H>
+#else
+#include <AMReX_MLABecLaplacian.H>
+#endif
+
+#include <hydro_NodalProjector.H>
+#include <hydro_MacProjector.H>
+
+#include <fstream>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Solver autotuning
+//
+//  Picks the multigrid options of the nodal projection, the MAC projection
+//  and the diffusion solves by timing them on the level 0 grids and data
+//  at the first coarse step:
+//
+//    autotune.solvers = 1
+//    autotune.file    = solver_tuning   # read on later runs, if present
+//    autotune.force   = 0               # retune even if the file exists
+//    autotune.nrep    = 2               # solves timed per candidate
+//    autotune.dry_run = 0               # stop after the tuned coarse step
+//
+//  The options are tuned one at a time (coordinate descent), starting from
+//  the values given in the inputs: an alternative value is kept if the
+//  solve converges and is faster. The result is an inputs fragment, which
+//  is read on top of the inputs by later runs and restarts.
+//---------------------------------------------------------------------
+
+namespace
+{
+    int         autotune_solvers = 0;
+    int         autotune_force   = 0;
+    int         autotune_nrep    = 2;
+    int         autotune_dry_run = 0;
+    std::string autotune_file("solver_tuning");
+    bool        autotune_pending = false;
+    bool        autotune_stop    = false;
+
+    //
+    // One tunable option: its ParmParse prefix and name, and the candidate
+    // values; the first candidate is the default of the solver.
+    //
+    struct Knob
+    {
+        std::string prefix;
+        std::string name;
+        Vector<std::string> values;
+    };
+
+    enum SolverKind { NodalSolve = 0, MacSolve, DiffusionSolve };
+
+    Vector<Knob> solver_knobs (SolverKind kind)
+    {
+        switch (kind)
+        {
+        case NodalSolve:
+            return {{"nodal_proj", "agglomeration",           {"1", "0"}},
+                    {"nodal_proj", "consolidation",           {"1", "0"}},
+                    {"nodal_proj", "use_gauss_seidel",        {"1", "0"}},
+                    {"nodal_proj", "use_harmonic_average",    {"0", "1"}},
+                    {"nodal_proj", "max_fmg_iter",            {"0", "1", "3"}},
+                    {"nodal_proj", "mg_max_coarsening_level", {"-1", "10", "4"}},
+                    {"nodal_proj", "bottom_solver",           {"bicgcg", "bicgstab", "cg", "smoother"}}};
+        case MacSolve:
+            return {{"mac_proj", "agglomeration",           {"1", "0"}},
+                    {"mac_proj", "consolidation",           {"1", "0"}},
+                    {"mac_proj", "max_fmg_iter",            {"-1", "0", "3"}},
+                    {"mac_proj", "mg_max_coarsening_level", {"100", "10", "4"}},
+                    {"mac_proj", "bottom_solver",           {"bicgcg", "bicgstab", "cg", "smoother"}}};
+        default:
+            return {{"diffuse", "agglomeration", {"1", "0"}},
+                    {"diffuse", "consolidation", {"1", "0"}},
+                    {"diffuse", "max_fmg_iter",  {"0", "1", "3"}}};
+        }
+    }
+
+    std::string knob_value (const Knob& k)
+    {
+        ParmParse pp(k.prefix);
+        std::string v = k.values[0];
+        pp.query(k.name.c_str(), v);
+        return v;
+    }
+
+    void set_knob (const Knob& k, const std::string& v)
+    {
+        ParmParse pp(k.prefix);
+        pp.add(k.name.c_str(), v);
+    }
+
+    template <typename T>
+    T query_or (const std::string& prefix, const char* name, T v)
+    {
+        ParmParse pp(prefix);
+        pp.query(name, v);
+        return v;
+    }
+
+    LPInfo mg_info (const std::string& prefix, int default_max_coarsening)
+    {
+        LPInfo info;
+        info.setAgglomeration(query_or(prefix, "agglomeration", 1) != 0);
+        info.setConsolidation(query_or(prefix, "consolidation", 1) != 0);
+        const int mcl = query_or(prefix, "mg_max_coarsening_level", default_max_coarsening);
+        if (mcl >= 0) {
+            info.setMaxCoarseningLevel(mcl);
+        }
+        return info;
+    }
+}
+
+void
+NavierStokesBase::read_autotune_params ()
+{
+    ParmParse pp("autotune");
+
+    pp.query("solvers", autotune_solvers);
+    pp.query("file",    autotune_file);
+    pp.query("force",   autotune_force);
+    pp.query("nrep",    autotune_nrep);
+    pp.query("dry_run", autotune_dry_run);
+
+    if (!autotune_solvers) return;
+
+    if (!autotune_force && amrex::FileExists(autotune_file))
+    {
+        //
+        // Reuse a previous tuning; this comes before the solvers read
+        // their options.
+        //
+        ParmParse::addfile(autotune_file);
+        amrex::Print() << "Solver options read from " << autotune_file << '\n';
+    }
+    else
+    {
+        autotune_pending = true;
+    }
+}
+
+//
+// Time nrep solves with the options currently in ParmParse; returns a
+// negative value if any of them does not converge.
+//
+Real
+NavierStokesBase::autotune_time_solve (int kind)
+{
+    const MultiFab& S = get_new_data(State_Type);
+    const Real tol_nodal = query_or("nodal_proj", "proj_tol", Real(1.e-12));
+    const Real abs_nodal = query_or("nodal_proj", "proj_abs_tol", Real(1.e-16));
+    const Real tol_mac   = query_or("mac_proj", "mac_tol", Real(1.e-12));
+    const Real abs_mac   = query_or("mac_proj", "mac_abs_tol", Real(1.e-16));
+
+    //
+    // 1/rho, as in the projections.
+    //
+    MultiFab sigma(grids, dmap, 1, 1, MFInfo(), Factory());
+    MultiFab::Copy(sigma, S, Density, 0, 1, 1);
+    sigma.invert(1.0, 1);
+
+    Real elapsed = 0.0;
+
+    try
+    {
+        for (int rep = 0; rep < autotune_nrep; ++rep)
+        {
+            ParallelDescriptor::Barrier();
+            const Real strt = ParallelDescriptor::second();
+
+            if (kind == NodalSolve)
+            {
+                MultiFab vel(grids, dmap, AMREX_SPACEDIM, 1, MFInfo(), Factory());
+                MultiFab::Copy(vel, S, Xvel, 0, AMREX_SPACEDIM, 1);
+                MultiFab phi(amrex::convert(grids, IntVect::TheNodeVector()), dmap, 1, 1,
+                             MFInfo(), Factory());
+                phi.setVal(0.0);
+
+                std::array<LinOpBCType,AMREX_SPACEDIM> lobc, hibc;
+                for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
+                {
+                    if (geom.isPeriodic(idim)) {
+                        lobc[idim] = hibc[idim] = LinOpBCType::Periodic;
+                        continue;
+                    }
+                    lobc[idim] = phys_bc.lo(idim) == PhysBCType::outflow ? LinOpBCType::Dirichlet
+                               : phys_bc.lo(idim) == PhysBCType::inflow  ? LinOpBCType::inflow
+                               :                                           LinOpBCType::Neumann;
+                    hibc[idim] = phys_bc.hi(idim) == PhysBCType::outflow ? LinOpBCType::Dirichlet
+                               : phys_bc.hi(idim) == PhysBCType::inflow  ? LinOpBCType::inflow
+                               :                                           LinOpBCType::Neumann;
+                }
+
+                Hydro::NodalProjector proj({&vel}, {&sigma}, {geom}, mg_info("nodal_proj", -1));
+                proj.setDomainBC(lobc, hibc);
+                proj.getLinOp().setGaussSeidel(query_or("nodal_proj", "use_gauss_seidel", 1) != 0);
+                proj.getLinOp().setHarmonicAverage(query_or("nodal_proj", "use_harmonic_average", 0) != 0);
+                proj.getMLMG().setMaxFmgIter(query_or("nodal_proj", "max_fmg_iter", 0));
+                proj.getMLMG().setThrowException(true);
+                proj.project({&phi}, tol_nodal, abs_nodal);
+            }
+            else if (kind == MacSolve)
+            {
+                Array<MultiFab,AMREX_SPACEDIM> umac, beta;
+                for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
+                {
+                    const BoxArray fba = amrex::convert(grids, IntVect::TheDimensionVector(idim));
+                    umac[idim].define(fba, dmap, 1, 0, MFInfo(), Factory());
+                    beta[idim].define(fba, dmap, 1, 0, MFInfo(), Factory());
+                }
+                MultiFab vel(grids, dmap, AMREX_SPACEDIM, 1, MFInfo(), Factory());
+                MultiFab::Copy(vel, S, Xvel, 0, AMREX_SPACEDIM, 1);
+                Array<MultiFab,AMREX_SPACEDIM> tmp;
+                for (int idim = 0; idim < AMREX_SPACEDIM; ++idim) {
+                    tmp[idim].define(umac[idim].boxArray(), dmap, 1, 0, MFInfo(), Factory());
+                }
+                for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
+                {
+                    // Face velocity idim from cell velocity component idim.
+                    MultiFab vcomp(vel, amrex::make_alias, idim, 1);
+                    amrex::average_cellcenter_to_face(GetArrOfPtrs(tmp), vcomp, geom);
+                    MultiFab::Copy(umac[idim], tmp[idim], 0, 0, 1, 0);
+                }
+                amrex::average_cellcenter_to_face(GetArrOfPtrs(beta), sigma, geom);
+
+                Array<MLLinOp::BCType,AMREX_SPACEDIM> lobc, hibc;
+                MacProj::set_mac_solve_bc(lobc, hibc, phys_bc, geom);
+
+                Hydro::MacProjector macproj({GetArrOfPtrs(umac)}, {GetArrOfConstPtrs(beta)},
+                                            {geom}, mg_info("mac_proj", 100));
+                macproj.setDomainBC(lobc, hibc);
+                macproj.setLevelBC(0, nullptr);
+                macproj.getLinOp().setMaxOrder(query_or("mac_proj", "maxorder", 4));
+                const int fmg = query_or("mac_proj", "max_fmg_iter", -1);
+                if (fmg > -1) {
+                    macproj.getMLMG().setMaxFmgIter(fmg);
+                }
+                macproj.getMLMG().setThrowException(true);
+                macproj.project(tol_mac, abs_mac);
+            }
+            else
+            {
+                const Real dt   = parent->dtLevel(0);
+                const Real visc = visc_coef.empty() ? 0.0 : visc_coef[Xvel];
+
+                MultiFab soln(grids, dmap, 1, 1, MFInfo(), Factory());
+                MultiFab rhs (grids, dmap, 1, 0, MFInfo(), Factory());
+                soln.setVal(0.0);
+                MultiFab::Copy(rhs, S, Xvel, 0, 1, 0);
+
+                LPInfo info = mg_info("diffuse", -1);
+#ifdef AMREX_USE_EB
+                const auto& ebf = &dynamic_cast<EBFArrayBoxFactory const&>(Factory());
+                MLEBABecLap op({geom}, {grids}, {dmap}, info, {ebf});
+#else
+                MLABecLaplacian op({geom}, {grids}, {dmap}, info);
+#endif
+                op.setMaxOrder(Diffusion::maxOrder());
+
+                std::array<LinOpBCType,AMREX_SPACEDIM> lobc, hibc;
+                Diffusion::setDomainBC(lobc, hibc, get_desc_lst()[State_Type].getBC(Xvel));
+                op.setDomainBC(lobc, hibc);
+                op.setLevelBC(0, nullptr);
+                op.setScalars(1.0, std::max(visc, Real(1.e-3))*dt);
+                MultiFab acoef(grids, dmap, 1, 0, MFInfo(), Factory());
+                MultiFab::Copy(acoef, S, Density, 0, 1, 0);
+                op.setACoeffs(0, acoef);
+                Array<MultiFab,AMREX_SPACEDIM> bcoef;
+                for (int idim = 0; idim < AMREX_SPACEDIM; ++idim) {
+                    bcoef[idim].define(amrex::convert(grids, IntVect::TheDimensionVector(idim)),
+                                       dmap, 1, 0, MFInfo(), Factory());
+                    bcoef[idim].setVal(1.0);
+                }
+                op.setBCoeffs(0, GetArrOfConstPtrs(bcoef));
+
+                MLMG mlmg(op);
+                mlmg.setMaxFmgIter(query_or("diffuse", "max_fmg_iter", 0));
+                mlmg.setThrowException(true);
+                mlmg.solve({&soln}, {&rhs}, query_or("ns", "visc_tol", Real(1.e-10)), -1.0);
+            }
+
+            Real t = ParallelDescriptor::second() - strt;
+            ParallelDescriptor::ReduceRealMax(t);
+            elapsed = (rep == 0) ? t : std::min(elapsed, t);
+        }
+    }
+    catch (const std::exception&)
+    {
+        return -1.0;
+    }
+
+    return elapsed;
+}
+
+//
+// Tune at the first coarse step and apply the result.
+//
+void
+NavierStokesBase::autotune_solvers ()
+{
+    if (!autotune_pending) return;
+    autotune_pending = false;
+
+    BL_PROFILE("NavierStokesBase::autotune_solvers()");
+
+    AMREX_ASSERT(level == 0);
+
+    const char* solver_name[] = {"nodal projection", "MAC projection", "diffusion"};
+
+    Vector<Knob> tuned;
+
+    for (int kind = NodalSolve; kind <= DiffusionSolve; ++kind)
+    {
+        Vector<Knob> knobs = solver_knobs(static_cast<SolverKind>(kind));
+
+        Real best = autotune_time_solve(kind);
+        if (best < 0.0)
+        {
+            amrex::Print() << "Autotune: " << solver_name[kind]
+                           << " does not converge with the input options; not tuned\n";
+            continue;
+        }
+        const Real initial = best;
+
+        for (const auto& k : knobs)
+        {
+            const std::string current = knob_value(k);
+            std::string best_value = current;
+
+            for (const auto& v : k.values)
+            {
+                if (v == current) continue;
+
+                set_knob(k, v);
+                const Real t = autotune_time_solve(kind);
+                if (verbose) {
+                    amrex::Print() << "Autotune: " << k.prefix << '.' << k.name << " = " << v
+                                   << ": " << (t < 0.0 ? std::string("no convergence") : std::to_string(t))
+                                   << '\n';
+                }
+                if (t >= 0.0 && t < best) {
+                    best = t;
+                    best_value = v;
+                }
+            }
+            set_knob(k, best_value);
+            tuned.push_back({k.prefix, k.name, {best_value}});
+        }
+
+        amrex::Print() << "Autotune: " << solver_name[kind] << ' ' << initial
+                       << " s -> " << best << " s\n";
+    }
+
+    Projection::read_mg_params();
+    MacProj::read_mg_params();
+    Diffusion::read_mg_params();
+
+    if (ParallelDescriptor::IOProcessor())
+    {
+        std::ofstream ofs(autotune_file, std::ios::out|std::ios::trunc);
+        if (!ofs.good()) {
+            amrex::FileOpenFailed(autotune_file);
+        }
+        ofs << "# Solver options tuned on " << ParallelDescriptor::NProcs() << " ranks for "
+            << grids.size() << " level 0 grids of " << geom.Domain() << '\n';
+        for (const auto& k : tuned) {
+            ofs << k.prefix << '.' << k.name << " = " << k.values[0] << '\n';
+        }
+    }
+
+    amrex::Print() << "Autotune: solver options written to " << autotune_file << '\n';
+
+    //
+    // The run stops through okToContinue() once this step is done.
+    //
+    if (autotune_dry_run) {
+        autotune_stop = true;
+    }
+}
+
+bool
+NavierStokesBase::autotune_stop_requested ()
+{
+    return autotune_stop;
+}
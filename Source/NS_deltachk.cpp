@@ -0,0 +1,510 @@
+#include <NavierStokesBase.H>
+#include <AMReX_AsyncOut.H>
+#include <AMReX_FileSystem.H>
+#include <AMReX_NFiles.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <type_traits>
+
+#include <unistd.h>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Incremental (delta) checkpoints
+//
+//    ns.chk_full_interval = 4
+//    ns.chk_expand_dir    = .       # where delta checkpoints are expanded
+//
+//  With chk_full_interval > 1, only every chk_full_interval-th checkpoint
+//  is written in full; it is the base of the ones that follow it. In the
+//  others, the state MultiFabs whose BoxArray is the same as in the base
+//  are stored as deltas against the base: FABs whose data did not change
+//  at all take no space, and the others are in practice stored as they
+//  are. (They are XORed word by word with the base, keeping the nonzero
+//  low bytes, but any change of a value changes the low bytes of its
+//  mantissa, so this is rarely smaller.) The savings therefore come from
+//  the unchanged FABs only, e.g. from quiescent regions or from state
+//  types that are not advanced. MultiFabs whose BoxArray changed, e.g. on
+//  regridded levels, are written in full as usual.
+//
+//  A delta checkpoint has a DeltaCheckpoint file naming its base and its
+//  delta MultiFabs, each with an index <mf>_XH and data files <mf>_XD_nnnnn.
+//  When a run restarts from it, the base is read and a full checkpoint is
+//  built in a new directory <chk_expand_dir>/<chk>.expanded_<pid>_<time>,
+//  with links to the other files of the checkpoint, and Amr restarts from
+//  it; the directory is removed once the run is initialized. The delta and
+//  base checkpoints are only read, and must still be there at that time.
+//  The first checkpoint after a restart is full.
+//
+//  While Amr writes the checkpoint, the delta MultiFabs are swapped for
+//  placeholders of one cell per box, so their data are not written in
+//  full; the delta is then computed by reading the base back. Deltas are
+//  not used with asynchronous output, nor with Parareal, which restarts
+//  from its checkpoints within the run.
+//---------------------------------------------------------------------
+
+namespace
+{
+    int chk_full_interval = 0;
+
+    const std::string delta_version("IAMR-DeltaCheckpoint-V1");
+    const std::string delta_file("/DeltaCheckpoint");
+
+    //
+    // The base checkpoint, the BoxArray of each of its MultiFabs, and the
+    // number of checkpoints since; the delta MultiFabs of the checkpoint
+    // being written.
+    //
+    std::string                    chk_base;
+    std::map<std::string,BoxArray> chk_base_grids;
+    int                            chk_count = 0;
+    bool                           chk_is_delta = false;
+    Vector<std::string>            chk_delta_mfs;
+    //
+    // The data of the delta MultiFabs of the level being written, while
+    // the state holds their placeholders.
+    //
+    std::map<std::string,MultiFab> chk_held;
+    //
+    // The full checkpoint built from a delta one to restart from.
+    //
+    std::string chk_expanded;
+
+    using Word = std::conditional_t<sizeof(Real) == 8, std::uint64_t, std::uint32_t>;
+
+    enum : char { fab_unchanged = 0, fab_xor = 1, fab_raw = 2 };
+
+    //
+    // Delta of n words of data against base.
+    //
+    void encode (const Word* data, const Word* base, Long n, std::vector<char>& out)
+    {
+        std::vector<char> code;
+        code.reserve(n);
+        bool changed = false;
+        for (Long i = 0; i < n; ++i)
+        {
+            Word x = data[i] ^ base[i];
+            changed = changed || (x != 0);
+            int nbytes = 0;
+            for (Word y = x; y != 0; y >>= 8) ++nbytes;
+            code.push_back(static_cast<char>(nbytes));
+            for (int b = 0; b < nbytes; ++b, x >>= 8) {
+                code.push_back(static_cast<char>(x & 0xff));
+            }
+        }
+
+        const std::size_t raw = n*sizeof(Word);
+        if (!changed) {
+            out.push_back(fab_unchanged);
+        } else if (code.size() < raw) {
+            out.push_back(fab_xor);
+            out.insert(out.end(), code.begin(), code.end());
+        } else {
+            out.push_back(fab_raw);
+            const char* p = reinterpret_cast<const char*>(data);
+            out.insert(out.end(), p, p+raw);
+        }
+    }
+
+    //
+    // Inverse of encode(): base is overwritten with the data.
+    //
+    void decode (const char* in, std::size_t nbytes, Word* base, Long n)
+    {
+        const char* end = in + nbytes;
+        const char mode = *in++;
+        if (mode == fab_raw)
+        {
+            AMREX_ALWAYS_ASSERT(end - in == Long(n*sizeof(Word)));
+            std::memcpy(base, in, n*sizeof(Word));
+        }
+        else if (mode == fab_xor)
+        {
+            for (Long i = 0; i < n; ++i)
+            {
+                const int nb = static_cast<unsigned char>(*in++);
+                Word x = 0;
+                for (int b = 0; b < nb; ++b) {
+                    x |= Word(static_cast<unsigned char>(*in++)) << (8*b);
+                }
+                base[i] ^= x;
+            }
+            AMREX_ALWAYS_ASSERT(in == end);
+        }
+        else
+        {
+            AMREX_ALWAYS_ASSERT(mode == fab_unchanged && in == end);
+        }
+    }
+
+    //
+    // Remove the files VisMF::Write() wrote for the MultiFab mf_name.
+    //
+    void remove_vismf (const std::string& mf_name)
+    {
+        if (ParallelDescriptor::IOProcessor())
+        {
+            FileSystem::Remove(mf_name + "_H");
+            for (int i = 0; i < ParallelDescriptor::NProcs(); ++i)
+            {
+                const std::string dname = amrex::Concatenate(mf_name + "_D_", i, 5);
+                if (FileSystem::Exists(dname)) {
+                    FileSystem::Remove(dname);
+                }
+            }
+        }
+    }
+
+    //
+    // Write the delta of mf against the MultiFab base_name as mf_name.
+    //
+    void write_delta (const MultiFab& mf, const std::string& base_name, const std::string& mf_name)
+    {
+        MultiFab base(mf.boxArray(), mf.DistributionMap(), mf.nComp(), mf.nGrowVect(),
+                      MFInfo().SetArena(The_Pinned_Arena()));
+        VisMF::Read(base, base_name);
+
+        const int nboxes = mf.size();
+        Vector<Long> index(2*nboxes, 0);
+        Vector<int>  fileno(nboxes, 0);
+
+        std::vector<Word> data;
+        std::vector<std::vector<char>> blob(mf.local_size());
+        for (MFIter mfi(mf); mfi.isValid(); ++mfi)
+        {
+            const FArrayBox& fab = mf[mfi];
+            const Long n = fab.size()*sizeof(Real)/sizeof(Word);
+            data.resize(n);
+            Gpu::dtoh_memcpy(data.data(), fab.dataPtr(), n*sizeof(Word));
+            encode(data.data(), reinterpret_cast<const Word*>(base[mfi].dataPtr()), n,
+                   blob[mfi.LocalIndex()]);
+        }
+
+        const int  nfiles    = std::max(1, std::min(ParallelDescriptor::NProcs(), VisMF::GetNOutFiles()));
+        const bool groupSets = false;
+        const std::string prefix = mf_name + "_XD_";
+        for (NFilesIter nfi(nfiles, prefix, groupSets, true); nfi.ReadyToWrite(); ++nfi)
+        {
+            for (MFIter mfi(mf); mfi.isValid(); ++mfi)
+            {
+                const auto& b  = blob[mfi.LocalIndex()];
+                const int   gi = mfi.index();
+                index[2*gi]   = static_cast<Long>(nfi.Stream().tellp());
+                index[2*gi+1] = static_cast<Long>(b.size());
+                fileno[gi]    = NFilesIter::FileNumber(nfiles, ParallelDescriptor::MyProc(), groupSets);
+                nfi.Stream().write(b.data(), b.size());
+            }
+        }
+
+        ParallelDescriptor::ReduceLongSum(index.dataPtr(), index.size(),
+                                          ParallelDescriptor::IOProcessorNumber());
+        ParallelDescriptor::ReduceIntSum(fileno.dataPtr(), fileno.size(),
+                                         ParallelDescriptor::IOProcessorNumber());
+
+        if (ParallelDescriptor::IOProcessor())
+        {
+            std::ofstream ofs(mf_name + "_XH", std::ios::out|std::ios::trunc);
+            if (!ofs.good()) {
+                amrex::FileOpenFailed(mf_name + "_XH");
+            }
+            ofs << nboxes << '\n';
+            for (int i = 0; i < nboxes; ++i)
+            {
+                ofs << amrex::Concatenate("_XD_", fileno[i], 5) << ' '
+                    << index[2*i] << ' ' << index[2*i+1] << '\n';
+            }
+        }
+    }
+
+    //
+    // Apply the delta mf_name to the MultiFab base read from its base.
+    //
+    void read_delta (const std::string& mf_name, MultiFab& base)
+    {
+        Vector<char> fileCharPtr;
+        ParallelDescriptor::ReadAndBcastFile(mf_name + "_XH", fileCharPtr);
+        std::istringstream is(fileCharPtr.dataPtr(), std::istringstream::in);
+
+        int nboxes;
+        is >> nboxes;
+        AMREX_ALWAYS_ASSERT(nboxes == base.size());
+        Vector<std::string> fname(nboxes);
+        Vector<Long>        index(2*nboxes);
+        for (int i = 0; i < nboxes; ++i) {
+            is >> fname[i] >> index[2*i] >> index[2*i+1];
+        }
+
+        std::vector<char> buf;
+        std::vector<Word> data;
+        for (MFIter mfi(base); mfi.isValid(); ++mfi)
+        {
+            const int gi = mfi.index();
+            std::ifstream ifs(mf_name + fname[gi], std::ios::in|std::ios::binary);
+            if (!ifs.good()) {
+                amrex::FileOpenFailed(mf_name + fname[gi]);
+            }
+            buf.resize(index[2*gi+1]);
+            ifs.seekg(index[2*gi]);
+            ifs.read(buf.data(), buf.size());
+
+            FArrayBox& fab = base[mfi];
+            const Long n = fab.size()*sizeof(Real)/sizeof(Word);
+            data.resize(n);
+            Gpu::dtoh_memcpy(data.data(), fab.dataPtr(), n*sizeof(Word));
+            decode(buf.data(), buf.size(), data.data(), n);
+            Gpu::htod_memcpy(fab.dataPtr(), data.data(), n*sizeof(Word));
+        }
+    }
+}
+
+void
+NavierStokesBase::read_delta_checkpoint_params ()
+{
+    ParmParse pp("ns");
+
+    pp.query("chk_full_interval", chk_full_interval);
+}
+
+bool
+NavierStokesBase::delta_checkpoint_active ()
+{
+    return chk_full_interval > 1;
+}
+
+//
+// Decide, on level 0, whether the checkpoint about to be written is a
+// delta one, and swap the state MultiFabs of this level that will be
+// stored as deltas for placeholders.
+//
+void
+NavierStokesBase::delta_checkpoint_hold (const std::string& dir, bool dump_old)
+{
+    if (chk_full_interval <= 1) return;
+
+    //
+    // Amr writes to <chk>.temp and renames it when done.
+    //
+    std::string chk = dir;
+    const std::string temp(".temp");
+    if (chk.size() > temp.size() && chk.compare(chk.size()-temp.size(), temp.size(), temp) == 0) {
+        chk.erase(chk.size()-temp.size());
+    }
+
+    //
+    // Level 0 decides for the whole checkpoint.
+    //
+    if (level == 0)
+    {
+        chk_is_delta = !chk_base.empty() && chk_count % chk_full_interval != 0
+                       && !AsyncOut::UseAsyncOut() && FileSystem::Exists(chk_base);
+        if (!chk_is_delta)
+        {
+            chk_base = chk;
+            chk_base_grids.clear();
+            chk_count = 0;
+        }
+        chk_delta_mfs.clear();
+        ++chk_count;
+    }
+
+    const std::string LevelDir = amrex::Concatenate("Level_", level, 1);
+    for (int typ = 0; typ < desc_lst.size(); ++typ)
+    {
+        const std::string sd = amrex::Concatenate(LevelDir + "/SD_", typ, 1);
+        for (int t = 0; t < 2; ++t)
+        {
+            if (t == 1 && !(dump_old && state[typ].hasOldData())) continue;
+
+            const std::string name = sd + (t == 0 ? "_New_MF" : "_Old_MF");
+            MultiFab& mf = (t == 0) ? state[typ].newData() : state[typ].oldData();
+
+            if (!chk_is_delta)
+            {
+                chk_base_grids[name] = mf.boxArray();
+                continue;
+            }
+
+            const auto it = chk_base_grids.find(name);
+            if (it == chk_base_grids.end() || it->second != mf.boxArray()) continue;
+
+            const BoxArray& ba = mf.boxArray();
+            BoxArray cells(ba.size());
+            for (int i = 0; i < ba.size(); ++i) {
+                cells.set(i, Box(ba[i].smallEnd(), ba[i].smallEnd(), ba.ixType()));
+            }
+            MultiFab placeholder(cells, mf.DistributionMap(), 1, 0);
+            placeholder.setVal(0.0);
+            std::swap(mf, placeholder);
+            chk_held[name] = std::move(placeholder);
+        }
+    }
+}
+
+//
+// Put the held state MultiFabs back and write them as deltas.
+//
+void
+NavierStokesBase::delta_checkpoint (const std::string& dir, bool dump_old)
+{
+    BL_PROFILE("NavierStokesBase::delta_checkpoint()");
+
+    if (chk_full_interval <= 1 || !chk_is_delta) return;
+
+    const std::string LevelDir = amrex::Concatenate("Level_", level, 1);
+    for (int typ = 0; typ < desc_lst.size(); ++typ)
+    {
+        const std::string sd = amrex::Concatenate(LevelDir + "/SD_", typ, 1);
+        for (int t = 0; t < 2; ++t)
+        {
+            if (t == 1 && !(dump_old && state[typ].hasOldData())) continue;
+
+            const std::string name = sd + (t == 0 ? "_New_MF" : "_Old_MF");
+            const auto it = chk_held.find(name);
+            if (it == chk_held.end()) continue;
+
+            MultiFab& mf = (t == 0) ? state[typ].newData() : state[typ].oldData();
+            std::swap(mf, it->second);
+            chk_held.erase(it);
+
+            write_delta(mf, chk_base + "/" + name, dir + "/" + name);
+            ParallelDescriptor::Barrier();
+            remove_vismf(dir + "/" + name);
+            chk_delta_mfs.push_back(name);
+        }
+    }
+
+    if (level == parent->finestLevel() && ParallelDescriptor::IOProcessor())
+    {
+        std::ofstream ofs(dir + delta_file, std::ios::out|std::ios::trunc);
+        if (!ofs.good()) {
+            amrex::FileOpenFailed(dir + delta_file);
+        }
+        ofs << delta_version << '\n' << chk_base << '\n' << chk_delta_mfs.size() << '\n';
+        for (const auto& name : chk_delta_mfs) {
+            ofs << name << '\n';
+        }
+    }
+
+    if (verbose)
+    {
+        amrex::Print() << "NavierStokesBase::delta_checkpoint(): lev: " << level
+                       << ", delta against " << chk_base << '\n';
+    }
+}
+
+std::string
+NavierStokesBase::expand_delta_checkpoint (const std::string& chk)
+{
+    if (chk.empty() || !FileSystem::Exists(chk + delta_file)) return chk;
+
+    BL_PROFILE("NavierStokesBase::expand_delta_checkpoint()");
+
+    Vector<char> fileCharPtr;
+    ParallelDescriptor::ReadAndBcastFile(chk + delta_file, fileCharPtr);
+    std::istringstream is(fileCharPtr.dataPtr(), std::istringstream::in);
+
+    std::string version, base;
+    int nmfs;
+    is >> version >> base >> nmfs;
+    if (version != delta_version) {
+        amrex::Abort("NavierStokesBase::expand_delta_checkpoint(): bad " + chk + delta_file);
+    }
+    if (!FileSystem::Exists(base)) {
+        amrex::Abort("NavierStokesBase::expand_delta_checkpoint(): base checkpoint " + base
+                     + " of " + chk + " not found");
+    }
+    Vector<std::string> names(nmfs);
+    for (auto& name : names) {
+        is >> name;
+    }
+
+    //
+    // A new directory for each run, so that runs restarting from the same
+    // checkpoint do not share it.
+    //
+    std::string expand_dir(".");
+    ParmParse pp("ns");
+    pp.query("chk_expand_dir", expand_dir);
+
+    Vector<Long> tag{static_cast<Long>(::getpid()), static_cast<Long>(std::time(nullptr))};
+    ParallelDescriptor::Bcast(tag.dataPtr(), tag.size(), ParallelDescriptor::IOProcessorNumber());
+
+    namespace fs = std::filesystem;
+    fs::path leaf = fs::path(chk).lexically_normal();
+    if (!leaf.has_filename()) leaf = leaf.parent_path();
+    const std::string full = expand_dir + "/" + leaf.filename().string()
+                           + ".expanded_" + std::to_string(tag[0]) + "_" + std::to_string(tag[1]);
+
+    amrex::Print() << "Expanding delta checkpoint " << chk << " against " << base
+                   << " into " << full << '\n';
+
+    //
+    // Everything but the deltas is linked, or copied where links fail.
+    //
+    if (ParallelDescriptor::IOProcessor())
+    {
+        fs::create_directories(full);
+        for (const auto& entry : fs::recursive_directory_iterator(chk))
+        {
+            const fs::path rel = fs::relative(entry.path(), chk);
+            const fs::path dst = fs::path(full) / rel;
+            if (entry.is_directory())
+            {
+                fs::create_directories(dst);
+                continue;
+            }
+
+            const std::string r = rel.generic_string();
+            bool is_delta = (r == delta_file.substr(1));
+            for (const auto& name : names) {
+                is_delta = is_delta || r.rfind(name + "_X", 0) == 0;
+            }
+            if (is_delta) continue;
+
+            std::error_code ec;
+            fs::create_symlink(fs::absolute(entry.path()), dst, ec);
+            if (ec) {
+                fs::copy_file(entry.path(), dst, fs::copy_options::overwrite_existing);
+            }
+        }
+    }
+    ParallelDescriptor::Barrier();
+
+    for (const auto& name : names)
+    {
+        MultiFab mf;
+        VisMF::Read(mf, base + "/" + name);
+        read_delta(chk + "/" + name, mf);
+        VisMF::Write(mf, full + "/" + name);
+    }
+    ParallelDescriptor::Barrier();
+
+    chk_expanded = full;
+    return full;
+}
+
+void
+NavierStokesBase::remove_expanded_checkpoint ()
+{
+    if (chk_expanded.empty()) return;
+
+    ParallelDescriptor::Barrier();
+    if (ParallelDescriptor::IOProcessor())
+    {
+        //
+        // Removes the links, not the files of the checkpoint.
+        //
+        std::filesystem::remove_all(chk_expanded);
+    }
+    chk_expanded.clear();
+}
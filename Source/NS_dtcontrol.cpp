@@ -0,0 +1,231 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Error-controlled time step selection
+//
+//  With a positive tolerance, the growth of the coarse time step is set
+//  by a PI controller on an estimate of the time integration error
+//  instead of by change_max:
+//
+//    ns.dt_err_tol        = 1.e-3   relative tolerance; <= 0 disables
+//    ns.dt_err_safety     = 0.9
+//    ns.dt_err_kI         = 0.35    exponent of tol/e
+//    ns.dt_err_kP         = 0.2     exponent of e_old/e
+//    ns.dt_err_min_growth = 0.2
+//    ns.dt_err_max_growth = 2.0
+//
+//  Each level keeps the velocity at the start of its previous step. The
+//  linear extrapolation of u^n-1 and u^n to t^n+1,
+//
+//    u^p = u^n + (dt/dt_old) (u^n - u^n-1),
+//
+//  is a first-order prediction of the second-order u^n+1 at the same
+//  cells, with the same spatial discretization: their difference,
+//  dt (dt + dt_old)/2 u_tt to leading order, vanishes with dt. Its
+//  largest value relative to max |u| is the error e of a step; it bounds
+//  the error of the first-order predictor, so it overestimates the error
+//  of the scheme itself.
+//
+//  After each coarse step, when all levels are synchronized, e is taken
+//  as the largest error over the levels (each over its last sub-step),
+//  divided by the tolerance, and the next coarse dt is grown by
+//
+//    fac = safety (1/e)^kI (e_old/e)^kP,
+//
+//  limited to [min_growth, max_growth]. The CFL limit of estTimeStep
+//  still applies, the finer levels follow the coarse dt through n_cycle
+//  as before, and right after a regrid the pre-regrid dt is kept. Steps
+//  are not rejected: a large error only shrinks the next step. A level
+//  has no estimate on its first step after it is built (initialization,
+//  regrid or restart); until all of them have one, change_max applies.
+//---------------------------------------------------------------------
+
+namespace
+{
+    Real dt_err_tol        = -1.0;
+    Real dt_err_safety     = 0.9;
+    Real dt_err_kI         = 0.35;
+    Real dt_err_kP         = 0.2;
+    Real dt_err_min_growth = 0.2;
+    Real dt_err_max_growth = 2.0;
+
+    //
+    // Error of the last and of the previous coarse step, relative to the
+    // tolerance; negative until estimated.
+    //
+    Real dt_err     = -1.0;
+    Real dt_err_old = -1.0;
+}
+
+void
+NavierStokesBase::read_dt_control_params ()
+{
+    ParmParse pp("ns");
+
+    pp.query("dt_err_tol",        dt_err_tol);
+    pp.query("dt_err_safety",     dt_err_safety);
+    pp.query("dt_err_kI",         dt_err_kI);
+    pp.query("dt_err_kP",         dt_err_kP);
+    pp.query("dt_err_min_growth", dt_err_min_growth);
+    pp.query("dt_err_max_growth", dt_err_max_growth);
+
+    if (dt_err_tol > 0.0 && (dt_err_min_growth <= 0.0 || dt_err_max_growth < dt_err_min_growth)) {
+        amrex::Abort("NavierStokesBase::read_dt_control_params(): need 0 < dt_err_min_growth <= dt_err_max_growth");
+    }
+}
+
+bool
+NavierStokesBase::dt_control_active ()
+{
+    return dt_err_tol > 0.0;
+}
+
+Real
+NavierStokesBase::dt_control_factor ()
+{
+    if (dt_err_tol <= 0.0 || dt_err < 0.0) {
+        return -1.0;
+    }
+
+    Real fac = dt_err_max_growth;
+    if (dt_err > 0.0)
+    {
+        //
+        // Without a previous nonzero error, there is no P term.
+        //
+        const Real e_old = (dt_err_old > 0.0) ? dt_err_old : dt_err;
+        fac = dt_err_safety * std::pow(1.0/dt_err, dt_err_kI)
+                            * std::pow(e_old/dt_err, dt_err_kP);
+    }
+    return std::max(dt_err_min_growth, std::min(dt_err_max_growth, fac));
+}
+
+//
+// Keeps the velocity at the start of the previous step, before the time
+// levels are swapped for the next one.
+//
+void
+NavierStokesBase::dt_control_save_old ()
+{
+    //
+    // On the first step of this level, the old data is not a computed state.
+    //
+    if (dt_err_nsteps++ == 0)
+    {
+        dt_err_dtprev = -1.0;
+        return;
+    }
+
+    if (dt_err_uprev == nullptr) {
+        dt_err_uprev = std::make_unique<MultiFab>(grids,dmap,AMREX_SPACEDIM,0,MFInfo(),Factory());
+    }
+    MultiFab::Copy(*dt_err_uprev, get_old_data(State_Type), Xvel, 0, AMREX_SPACEDIM, 0);
+
+    dt_err_dtprev = state[State_Type].curTime() - state[State_Type].prevTime();
+}
+
+//
+// Local max over the valid cells of |u^n+1 - u^p| and of |u^n+1|; diff is
+// negative when the level has no previous step.
+//
+void
+NavierStokesBase::dt_control_level_error (Real& diff, Real& umax)
+{
+    diff = -1.0;
+    umax = 0.0;
+
+    if (dt_err_uprev == nullptr || dt_err_dtprev <= 0.0) return;
+
+    const MultiFab& U_old = get_old_data(State_Type);
+    const MultiFab& U_new = get_new_data(State_Type);
+    const MultiFab& U_prv = *dt_err_uprev;
+
+    const Real ratio = (state[State_Type].curTime() - state[State_Type].prevTime())
+                     / dt_err_dtprev;
+
+    ReduceOps<ReduceOpMax,ReduceOpMax> reduce_op;
+    ReduceData<Real,Real> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+    for (MFIter mfi(U_new,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+    {
+        const Box& bx = mfi.tilebox();
+
+        const auto& up = U_prv.const_array(mfi);
+        const auto& uo = U_old.const_array(mfi, Xvel);
+        const auto& un = U_new.const_array(mfi, Xvel);
+#ifdef AMREX_USE_EB
+        const auto& vfrac = EBFactory().getVolFrac().const_array(mfi);
+#endif
+
+        reduce_op.eval(bx, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i, int j, int k) noexcept -> ReduceTuple
+        {
+#ifdef AMREX_USE_EB
+            if (vfrac(i,j,k) == 0.0) return {0.0, 0.0};
+#endif
+            Real d = 0.0;
+            Real u = 0.0;
+            for (int n = 0; n < AMREX_SPACEDIM; ++n) {
+                const Real pred = uo(i,j,k,n) + ratio*(uo(i,j,k,n) - up(i,j,k,n));
+                d = amrex::max(d, amrex::Math::abs(un(i,j,k,n) - pred));
+                u = amrex::max(u, amrex::Math::abs(un(i,j,k,n)));
+            }
+            return {d, u};
+        });
+    }
+
+    ReduceTuple hv = reduce_data.value(reduce_op);
+    diff = std::max(amrex::get<0>(hv), Real(0.0));
+    umax = std::max(amrex::get<1>(hv), Real(0.0));
+}
+
+void
+NavierStokesBase::dt_control_estimate ()
+{
+    BL_PROFILE("NavierStokesBase::dt_control_estimate()");
+
+    AMREX_ASSERT(level == 0);
+
+    const int  finest_level = parent->finestLevel();
+    const Real small        = 1.0e-8;
+
+    Vector<Real> e(2*(finest_level+1));
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        getLevel(lev).dt_control_level_error(e[2*lev], e[2*lev+1]);
+    }
+
+    ParallelDescriptor::ReduceRealMax(e.dataPtr(), e.size());
+
+    Real err = 0.0;
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        //
+        // A level without a previous step leaves no estimate for this step.
+        //
+        if (e[2*lev] < 0.0)
+        {
+            dt_err     = -1.0;
+            dt_err_old = -1.0;
+            return;
+        }
+        err = std::max(err, e[2*lev]/std::max(e[2*lev+1], small));
+    }
+    err /= dt_err_tol;
+
+    dt_err_old = (dt_err < 0.0) ? err : dt_err;
+    dt_err     = err;
+
+    if (verbose)
+    {
+        amrex::Print() << "NavierStokesBase::dt_control_estimate(): error/tol = " << dt_err
+                       << ", dt growth factor = " << dt_control_factor() << '\n';
+    }
+}
@@ -142,4 +142,6 @@ NavierStokes::errorEst (TagBoxArray& tags,
   //
   // If needed, hard-code error function here
   //
+
+  regrid_track_tags(tags,tagval);
 }
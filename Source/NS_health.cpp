@@ -0,0 +1,292 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_PlotFileUtil.H>
+#include <AMReX_Utility.H>
+
+#include <limits>
+#include <sstream>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Numerical health monitor
+//
+//    health.int          = 1           # check every step of each level; <= 0 disables
+//    health.density      = 0.1 10.0    # bounds of any state variable, by name
+//    health.tracer       = 0.0 1.0
+//    health.max_divu     = 1.e3        # max |div u|, <= 0 to skip
+//    health.max_vel_jump = 10.0        # max velocity jump between cells, <= 0 to skip
+//    health.on_failure   = plotfile    # plotfile, checkpoint or none
+//    health.plot_file    = plt_failure
+//
+//  After the scalar and the velocity updates of a level, every health.int
+//  steps of the level, the new state components just updated are checked
+//  in a single pass and a single reduction: no component may be NaN or
+//  infinite or outside its bounds and, after the velocity update, the
+//  largest divergence and velocity jump between neighboring cells must
+//  be below their limits. Divergence and jumps are computed from the
+//  valid cells of each grid only.
+//
+//  On failure, the first offending cell of each grid is reported with its
+//  box, index, location and values, an emergency plotfile of the state
+//  on all levels (or a checkpoint) is written, and the run aborts.
+//---------------------------------------------------------------------
+
+namespace
+{
+    int         health_int          = 1;
+    Real        health_max_divu     = -1.0;
+    Real        health_max_vel_jump = -1.0;
+    std::string health_on_failure("plotfile");
+    std::string health_plot_file("plt_failure");
+
+    //
+    // Bounds of the state components, read on first use since the names
+    // are only known after the parameters are read.
+    //
+    Vector<Real> health_lo;
+    Vector<Real> health_hi;
+}
+
+void
+NavierStokesBase::read_health_params ()
+{
+    ParmParse pp("health");
+
+    pp.query("int",          health_int);
+    pp.query("max_divu",     health_max_divu);
+    pp.query("max_vel_jump", health_max_vel_jump);
+    pp.query("on_failure",   health_on_failure);
+    pp.query("plot_file",    health_plot_file);
+
+    if (health_on_failure != "plotfile" && health_on_failure != "checkpoint" &&
+        health_on_failure != "none")
+    {
+        amrex::Abort("NavierStokesBase::read_health_params(): health.on_failure must be plotfile, checkpoint or none");
+    }
+}
+
+void
+NavierStokesBase::health_check (const std::string& phase, int scomp, int ncomp, bool velocity)
+{
+    if (health_int <= 0 || parent->levelSteps(level) % health_int != 0) return;
+
+    BL_PROFILE("NavierStokesBase::health_check()");
+
+    const Real big = std::numeric_limits<Real>::max();
+
+    if (health_lo.empty())
+    {
+        ParmParse pp("health");
+        health_lo.resize(NUM_STATE, -big);
+        health_hi.resize(NUM_STATE,  big);
+        for (int n = 0; n < NUM_STATE; ++n)
+        {
+            const std::string& name = desc_lst[State_Type].name(n);
+            if (pp.countval(name.c_str()) == 2)
+            {
+                pp.get(name.c_str(), health_lo[n], 0);
+                pp.get(name.c_str(), health_hi[n], 1);
+            }
+            else if (pp.contains(name.c_str()))
+            {
+                amrex::Abort("NavierStokesBase::health_check(): health." + name + " needs a lower and an upper bound");
+            }
+        }
+    }
+
+    Gpu::DeviceVector<Real> d_lo(ncomp), d_hi(ncomp);
+    Gpu::copyAsync(Gpu::hostToDevice, health_lo.begin()+scomp, health_lo.begin()+scomp+ncomp, d_lo.begin());
+    Gpu::copyAsync(Gpu::hostToDevice, health_hi.begin()+scomp, health_hi.begin()+scomp+ncomp, d_hi.begin());
+    const Real* lo = d_lo.data();
+    const Real* hi = d_hi.data();
+
+    const MultiFab& S = get_new_data(State_Type);
+    const auto dxinv  = geom.InvCellSizeArray();
+    const bool do_div  = velocity && health_max_divu > 0.0;
+    const bool do_jump = velocity && health_max_vel_jump > 0.0;
+
+    ReduceOps<ReduceOpMax,ReduceOpMax,ReduceOpMax> reduce_op;
+    ReduceData<Real,Real,Real> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+    for (MFIter mfi(S,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+    {
+        const Box& bx  = mfi.tilebox();
+        const auto vlo = amrex::lbound(mfi.validbox());
+        const auto vhi = amrex::ubound(mfi.validbox());
+        auto const& s  = S.const_array(mfi);
+#ifdef AMREX_USE_EB
+        auto const& vfrac = EBFactory().getVolFrac().const_array(mfi);
+#endif
+
+        reduce_op.eval(bx, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i, int j, int k) noexcept -> ReduceTuple
+        {
+#ifdef AMREX_USE_EB
+            if (vfrac(i,j,k) == 0.0) return {0.0, 0.0, 0.0};
+#endif
+            //
+            // Fails for NaN as well as out of bounds.
+            //
+            Real bad = 0.0;
+            for (int n = 0; n < ncomp; ++n)
+            {
+                const Real v = s(i,j,k,scomp+n);
+                if (!(amrex::Math::abs(v) <= big && v >= lo[n] && v <= hi[n])) bad = 1.0;
+            }
+
+            Real div = 0.0, jump = 0.0;
+            if (do_div || do_jump)
+            {
+                const int ijk[3] = {i, j, k};
+                const int clo[3] = {vlo.x, vlo.y, vlo.z};
+                const int chi[3] = {vhi.x, vhi.y, vhi.z};
+                bool interior = true;
+                for (int d = 0; d < AMREX_SPACEDIM; ++d)
+                {
+                    const int di = (d == 0), dj = (d == 1), dk = (d == 2);
+                    if (ijk[d] > clo[d]) {
+                        for (int n = 0; n < AMREX_SPACEDIM; ++n) {
+                            jump = amrex::max(jump, amrex::Math::abs(s(i,j,k,Xvel+n) - s(i-di,j-dj,k-dk,Xvel+n)));
+                        }
+                    }
+                    if (ijk[d] > clo[d] && ijk[d] < chi[d]) {
+                        div += 0.5*dxinv[d]*(s(i+di,j+dj,k+dk,Xvel+d) - s(i-di,j-dj,k-dk,Xvel+d));
+                    } else {
+                        interior = false;
+                    }
+                }
+                div = interior ? amrex::Math::abs(div) : 0.0;
+            }
+            return {bad, div, jump};
+        });
+    }
+
+    ReduceTuple hv = reduce_data.value(reduce_op);
+    Real r[3] = { amrex::get<0>(hv), amrex::get<1>(hv), amrex::get<2>(hv) };
+    ParallelDescriptor::ReduceRealMax(r, 3);
+
+    const bool failed = r[0] > 0.0 || (do_div && r[1] > health_max_divu)
+                                   || (do_jump && r[2] > health_max_vel_jump);
+    if (failed) {
+        health_failure(phase, scomp, ncomp, r[1], r[2]);
+    }
+}
+
+void
+NavierStokesBase::health_failure (const std::string& phase, int scomp, int ncomp,
+                                  Real max_divu, Real max_jump)
+{
+    const Real big       = std::numeric_limits<Real>::max();
+    const Real divu_lim  = (max_divu > health_max_divu && health_max_divu > 0.0) ? health_max_divu : big;
+    const Real jump_lim  = (max_jump > health_max_vel_jump && health_max_vel_jump > 0.0) ? health_max_vel_jump : big;
+
+    amrex::Print() << "NavierStokesBase::health_check(): lev: " << level
+                   << ", step: " << parent->levelSteps(level)
+                   << ", after " << phase << ": unhealthy state"
+                   << " (max |div u| = " << max_divu
+                   << ", max velocity jump = " << max_jump << ")\n";
+
+    //
+    // The first offending cell of each grid, found on the host.
+    //
+    const MultiFab& S = get_new_data(State_Type);
+    const auto dx     = geom.CellSizeArray();
+    const auto plo    = geom.ProbLoArray();
+    for (MFIter mfi(S); mfi.isValid(); ++mfi)
+    {
+        const Box& vbx = mfi.validbox();
+        FArrayBox fab(S[mfi].box(), NUM_STATE, The_Pinned_Arena());
+        fab.copy<RunOn::Device>(S[mfi], 0, 0, NUM_STATE);
+        Gpu::streamSynchronize();
+        auto const& s = fab.const_array();
+
+        const auto lo = amrex::lbound(vbx);
+        const auto hi = amrex::ubound(vbx);
+        bool found = false;
+        for (int k = lo.z; k <= hi.z && !found; ++k) {
+        for (int j = lo.y; j <= hi.y && !found; ++j) {
+        for (int i = lo.x; i <= hi.x && !found; ++i)
+        {
+            bool bad = false;
+            for (int n = scomp; n < scomp+ncomp; ++n)
+            {
+                const Real v = s(i,j,k,n);
+                bad = bad || !(std::abs(v) <= big && v >= health_lo[n] && v <= health_hi[n]);
+            }
+            const IntVect iv(AMREX_D_DECL(i,j,k));
+            for (int d = 0; d < AMREX_SPACEDIM && !bad; ++d)
+            {
+                const IntVect e = IntVect::TheDimensionVector(d);
+                if (iv[d] > vbx.smallEnd(d)) {
+                    for (int n = 0; n < AMREX_SPACEDIM; ++n) {
+                        bad = bad || std::abs(fab(iv,Xvel+n) - fab(iv-e,Xvel+n)) > jump_lim;
+                    }
+                }
+            }
+            if (!bad && divu_lim < big && amrex::grow(vbx,-1).contains(iv))
+            {
+                Real div = 0.0;
+                for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                    const IntVect e = IntVect::TheDimensionVector(d);
+                    div += 0.5*(fab(iv+e,Xvel+d) - fab(iv-e,Xvel+d))/dx[d];
+                }
+                bad = std::abs(div) > divu_lim;
+            }
+            if (!bad) continue;
+
+            found = true;
+            std::ostringstream msg;
+            msg << "  grid " << vbx << ", cell " << iv << ", x = (";
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                msg << (d > 0 ? ", " : "") << plo[d] + (iv[d]+0.5)*dx[d];
+            }
+            msg << "):";
+            for (int n = scomp; n < scomp+ncomp; ++n) {
+                msg << ' ' << desc_lst[State_Type].name(n) << " = " << s(i,j,k,n);
+            }
+            amrex::AllPrint() << msg.str() << '\n';
+        }}}
+    }
+    ParallelDescriptor::Barrier();
+
+    if (health_on_failure == "checkpoint")
+    {
+        parent->checkPoint();
+    }
+    else if (health_on_failure == "plotfile")
+    {
+        //
+        // The new state of all levels, as it is.
+        //
+        const int finest_level = parent->finestLevel();
+        Vector<MultiFab> out(finest_level+1);
+        Vector<Geometry> geoms(finest_level+1);
+        Vector<int>      steps(finest_level+1);
+        Vector<IntVect>  ratios(finest_level);
+        Vector<std::string> names;
+        for (int n = 0; n < NUM_STATE; ++n) {
+            names.push_back(desc_lst[State_Type].name(n));
+        }
+        for (int lev = 0; lev <= finest_level; ++lev)
+        {
+            const MultiFab& Slev = getLevel(lev).get_new_data(State_Type);
+            out[lev].define(Slev.boxArray(), Slev.DistributionMap(), NUM_STATE, 0);
+            MultiFab::Copy(out[lev], Slev, 0, 0, NUM_STATE, 0);
+            geoms[lev] = parent->Geom(lev);
+            steps[lev] = parent->levelSteps(lev);
+            if (lev < finest_level) ratios[lev] = parent->refRatio(lev);
+        }
+
+        const std::string pltfile = amrex::Concatenate(health_plot_file, parent->levelSteps(0), 5);
+        amrex::WriteMultiLevelPlotfile(pltfile, finest_level+1, amrex::GetVecOfConstPtrs(out),
+                                       names, geoms, state[State_Type].curTime(), steps, ratios);
+        amrex::Print() << "NavierStokesBase::health_check(): wrote " << pltfile << '\n';
+    }
+
+    amrex::Abort("NavierStokesBase::health_check(): unhealthy state after " + phase);
+}
@@ -5,6 +5,7 @@ using namespace amrex;
 #include <AMReX_EB2.H>
 #include <AMReX_EB2_IF.H>
 #include <EBUserDefined.H>
+#include <NS_stl.H>
 #include <NSB_K.H>
 
 #include <AMReX_ParmParse.H>
@@ -13,6 +14,12 @@ using namespace amrex;
 #include <AMReX_BoxArray.H>
 #include "AMReX_VisMF.H"
 #include "AMReX_PlotFileUtil.H"
+#include <AMReX_Utility.H>
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 
 
 
@@ -66,16 +73,14 @@ void reentrant_profile(std::vector<amrex::RealVect> &points) {
 }
 #endif
 
-// called in main before Amr->init(start,stop)
+//
+// Builds the EB index space from the implicit function selected by geom_type.
+//
+static
 void
-initialize_EB2 (const Geometry& geom, int required_coarsening_level,
-                int max_coarsening_level)
+build_EB2_geometry (const std::string& geom_type, const Geometry& geom,
+                    int required_coarsening_level, int max_coarsening_level)
 {
-    // read in EB parameters
-    ParmParse ppeb2("eb2");
-    std::string geom_type;
-    ppeb2.get("geom_type", geom_type);
-
   if (geom_type == "combustor")
   {
 #if (AMREX_SPACEDIM == 2)
@@ -376,6 +381,43 @@ initialize_EB2 (const Geometry& geom, int required_coarsening_level,
     auto gshop = EB2::makeShop(square_grid);
     // Build index space
     EB2::Build(gshop, geom, required_coarsening_level, max_coarsening_level);
+#endif
+  }
+  else if (geom_type == "stl")
+  {
+#if (AMREX_SPACEDIM == 2)
+    Abort("geom_type 'stl' only available in 3D");
+#elif (AMREX_SPACEDIM == 3)
+    ParmParse pp("eb2");
+
+    std::string stl_file;
+    pp.get("stl_file", stl_file);
+
+    Real stl_scale = 1.0;
+    pp.query("stl_scale", stl_scale);
+
+    Vector<Real> stl_center{0.0, 0.0, 0.0};
+    pp.queryarr("stl_center", stl_center);
+
+    bool stl_reverse_normal = false;
+    pp.query("stl_reverse_normal", stl_reverse_normal);
+
+    //
+    // Only the sign of the implicit function matters away from the surface,
+    // so the distance is clipped to a couple of cells of the coarsest EB level.
+    //
+    Real dx_max = 0.0;
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim) {
+        dx_max = std::max(dx_max, geom.CellSize(idim));
+    }
+    Real stl_max_distance = 2.0*std::sqrt(3.0)*dx_max*std::pow(2.0, max_coarsening_level);
+    pp.query("stl_max_distance", stl_max_distance);
+
+    STLIF stl(stl_file, stl_scale, {stl_center[0], stl_center[1], stl_center[2]},
+              stl_reverse_normal, stl_max_distance);
+
+    auto gshop = EB2::makeShop(stl);
+    EB2::Build(gshop, geom, required_coarsening_level, max_coarsening_level);
 #endif
   }
   else if (geom_type == "UserDefined") {
@@ -387,6 +429,176 @@ initialize_EB2 (const Geometry& geom, int required_coarsening_level,
   }
 }
 
+//
+// FNV-1a, so that the keys are identical across ranks and runs.
+//
+static
+void
+eb2_fnv1a (std::uint64_t& h, const char* data, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+}
+
+//
+// Hash of the contents of a file, read on the I/O rank.
+//
+static
+std::uint64_t
+eb2_file_hash (const std::string& file)
+{
+    Long h = 0;
+    if (ParallelDescriptor::IOProcessor())
+    {
+        std::ifstream ifs(file, std::ios::in|std::ios::binary);
+        if (!ifs.good()) {
+            amrex::FileOpenFailed(file);
+        }
+        std::uint64_t fh = 14695981039346656037ULL;
+        std::vector<char> buf(1 << 20);
+        while (ifs)
+        {
+            ifs.read(buf.data(), buf.size());
+            eb2_fnv1a(fh, buf.data(), ifs.gcount());
+        }
+        h = static_cast<Long>(fh);
+    }
+    ParallelDescriptor::Bcast(&h, 1, ParallelDescriptor::IOProcessorNumber());
+    return static_cast<std::uint64_t>(h);
+}
+
+//
+// Key of the on-disk EB cache: a hash of every eb2.* parameter, of the
+// parameter groups read by the built-in shapes (plus any listed in
+// eb2.cache_prefixes), of the problem geometry, of the coarsening levels
+// and, for stl, of the contents of the STL file.
+//
+static
+std::string
+eb2_cache_key (const std::string& geom_type, const Geometry& geom,
+               int required_coarsening_level, int max_coarsening_level)
+{
+    std::ostringstream os;
+    os << std::setprecision(17);
+    os << AMREX_SPACEDIM << ';' << amrex::Version() << ';' << geom_type << ';'
+       << geom.Domain() << ';' << geom.Coord() << ';'
+       << required_coarsening_level << ';' << max_coarsening_level << ';';
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim) {
+        os << geom.ProbLo(idim) << ' ' << geom.ProbHi(idim) << ' '
+           << geom.isPeriodic(idim) << ';';
+    }
+
+    Vector<std::string> prefixes{"eb2", "combustor", "pipe", "square_grid"};
+    ParmParse ppeb2("eb2");
+    Vector<std::string> extra_prefixes;
+    ppeb2.queryarr("cache_prefixes", extra_prefixes);
+    for (const auto& p : extra_prefixes) {
+        prefixes.push_back(p);
+    }
+
+    ParmParse pp;
+    for (const auto& prefix : prefixes)
+    {
+        // getEntries returns a sorted set, so the ordering is canonical
+        for (const auto& name : ParmParse::getEntries(prefix))
+        {
+            if (name == "eb2.use_cache" || name == "eb2.cache_dir") {
+                continue;
+            }
+            Vector<std::string> vals;
+            pp.getarr(name.c_str(), vals);
+            os << name << '=';
+            for (const auto& v : vals) {
+                os << v << ' ';
+            }
+            os << ';';
+        }
+    }
+
+    if (geom_type == "stl")
+    {
+        std::string stl_file;
+        ppeb2.get("stl_file", stl_file);
+        os << "stl_hash=" << eb2_file_hash(stl_file) << ';';
+    }
+
+    const std::string str = os.str();
+    std::uint64_t h = 14695981039346656037ULL;
+    eb2_fnv1a(h, str.data(), str.size());
+
+    std::ostringstream key;
+    key << "eb2_" << std::hex << std::setw(16) << std::setfill('0') << h;
+    return key.str();
+}
+
+// called in main before Amr->init(start,stop)
+void
+initialize_EB2 (const Geometry& geom, int required_coarsening_level,
+                int max_coarsening_level)
+{
+    // read in EB parameters
+    ParmParse ppeb2("eb2");
+    std::string geom_type;
+    ppeb2.get("geom_type", geom_type);
+
+    //
+    // Optionally reuse the EB level data (flags, fractions, centroids)
+    // written by a previous run with the same geometry parameters.
+    //
+    bool use_cache = false;
+    ppeb2.query("use_cache", use_cache);
+
+    //
+    // The code of a user-defined geometry is not part of the key, so its
+    // cache entries are only trusted when they are given a version.
+    //
+    if (use_cache && geom_type == "UserDefined" && !ppeb2.contains("user_version"))
+    {
+        amrex::Print() << "initialize_EB2: eb2.use_cache ignored for UserDefined geometry without eb2.user_version\n";
+        use_cache = false;
+    }
+
+    if (!use_cache || geom_type == "chkfile")
+    {
+        build_EB2_geometry(geom_type, geom, required_coarsening_level, max_coarsening_level);
+        return;
+    }
+
+    std::string cache_dir = "eb2_cache";
+    ppeb2.query("cache_dir", cache_dir);
+
+    const std::string chkfile = cache_dir + "/"
+        + eb2_cache_key(geom_type, geom, required_coarsening_level, max_coarsening_level);
+
+    const Real strt_time = ParallelDescriptor::second();
+
+    if (amrex::FileExists(chkfile + "/Header"))
+    {
+        amrex::Print() << "initialize_EB2: reading EB geometry from cache " << chkfile << '\n';
+        EB2::BuildFromChkptFile(chkfile, geom, required_coarsening_level, max_coarsening_level);
+    }
+    else
+    {
+        build_EB2_geometry(geom_type, geom, required_coarsening_level, max_coarsening_level);
+
+        if (ParallelDescriptor::IOProcessor()) {
+            if (!amrex::UtilCreateDirectory(cache_dir, 0755)) {
+                amrex::CreateDirectoryFailed(cache_dir);
+            }
+        }
+        ParallelDescriptor::Barrier();
+
+        amrex::Print() << "initialize_EB2: writing EB geometry to cache " << chkfile << '\n';
+        EB2::IndexSpace::top().getLevel(geom).write_to_chkfile(chkfile);
+    }
+
+    Real run_time = ParallelDescriptor::second() - strt_time;
+    ParallelDescriptor::ReduceRealMax(run_time, ParallelDescriptor::IOProcessorNumber());
+    amrex::Print() << "initialize_EB2: time: " << run_time << '\n';
+}
+
 void
 NavierStokesBase::init_eb (const Geometry& /*level_geom*/, const BoxArray& /*ba*/, const DistributionMapping& /*dm*/)
 {
@@ -0,0 +1,650 @@
+#include <NavierStokesBase.H>
+#include <AMReX_Amr.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_FileSystem.H>
+#include <AMReX_Utility.H>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+using namespace amrex;
+
+amrex::LevelBld* getLevelBld ();
+
+#ifdef AMREX_USE_EB
+void initialize_EB2 (const Geometry& geom, int required_level, int max_level);
+#endif
+
+//--------------------------------------------------------------------
+// Parareal time slicing
+//
+//    main3d.ex inputs parareal.nslices=4
+//
+//    parareal.max_iter   = 4          # default: nslices
+//    parareal.tol        = 1.e-6      # on max |du| / max |u| at the slice ends
+//    parareal.coarse_cfl = 0.9        # default: ns.cfl
+//    parareal.dir        = parareal   # scratch directory for the slice checkpoints
+//
+//  [strt_time, stop_time] is cut into nslices equal slices, and the
+//  ranks into as many groups, each running AMReX on its own communicator
+//  for one slice. nslices must be given on the command line, since the
+//  communicators are split before AMReX reads the inputs.
+//
+//  The Parareal state U_n at the slice boundaries T_n is the level 0
+//  state. The coarse propagator G runs level 0 only (amr.max_level = 0)
+//  with parareal.coarse_cfl; the fine propagator F is the normal run.
+//  After a sequential sweep of G gives the first U_n, every iteration
+//
+//    - runs F over all unconverged slices concurrently, each restarting
+//      from the checkpoint of the previous slice's F run,
+//    - sweeps G again slice after slice, each group receiving U_n from
+//      the previous group and sending
+//
+//          U_n+1 = G(U_n) + F(U_n_old) - G(U_n_old)
+//
+//      to the next one.
+//
+//  The correction is added to the whole hierarchy at the next fine
+//  restart: level 0 is set to U_n+1, and the finer levels get the level 0
+//  change injected. Slices that start from a level 0 state only (the
+//  first iteration) fill the finer levels from level 0 and regrid. The
+//  pressure is carried along, not corrected.
+//
+//  The iteration stops when the largest change of U_n+1 over the slices
+//  is below tol, or after max_iter iterations; after k iterations the
+//  first k slices equal the serial run. The group of the last slice then
+//  writes the checkpoint and plotfile at stop_time. No other plotfiles or
+//  checkpoints are written, and the in-situ diagnostics are suspended, as
+//  each group would write its own. The divergence constraint source
+//  (divu), the error-controlled time step and delta checkpoints are not
+//  supported.
+//---------------------------------------------------------------------
+
+#ifdef AMREX_USE_MPI
+namespace
+{
+    struct Parareal
+    {
+        int  slice      = 0;      // Time slice of this group.
+        int  nslices    = 1;
+        int  max_iter   = -1;
+        Real tol        = 1.e-6;
+        Real fine_cfl   = 0.5;
+        Real coarse_cfl = -1.0;
+        Real fine_fixed_dt = -1.0;
+        int  fine_max_level = 0;
+        int  digits     = 5;
+        std::string dir("parareal");
+        std::string check_file("chk");
+
+        Real t0 = 0.0, t1 = 0.0;  // This slice.
+
+        //
+        // Level 0 states on a layout shared by all the groups, so that
+        // rank r of a group exchanges them with rank r of the next.
+        //
+        BoxArray            ba;
+        DistributionMapping dm;
+        MultiFab U,  P;           // Start of the slice, U_n.
+        MultiFab G;               // G(U_n) of the last sweep.
+        MultiFab F,  FP;          // F(U_n) of the last fine run.
+        MultiFab Un, Pn;          // End of the slice, U_n+1.
+
+        std::string base_file;    // Level 0 checkpoint the G runs restart from.
+        std::string init_file;    // Initial hierarchy (slice 0).
+        Real fine_steps = -1.0;   // Steps of the last F checkpoint of this slice.
+        Real prev_steps = -1.0;   // Same for the previous slice.
+        int  last_fine  = -1;     // Iteration of the last F run.
+        Vector<std::string> fine_files;  // F checkpoints of this slice, by iteration.
+
+        int group_size = 1;
+
+        std::string fine_root (int iter, int s) const
+        {
+            return dir + "/F_it" + std::to_string(iter) + "_s" + std::to_string(s) + "_chk";
+        }
+
+        std::unique_ptr<Amr> make_amr (int max_level, const std::string& restart,
+                                       const std::string& root) const
+        {
+            //
+            // Replace the entries of the last hierarchy rather than adding
+            // to them.
+            //
+            ParmParse pp("amr");
+            pp.remove("max_level");
+            pp.remove("restart");
+            pp.remove("check_file");
+            pp.add("max_level", max_level);
+            pp.add("restart", restart);
+            pp.add("check_file", root);
+            return std::make_unique<Amr>(getLevelBld());
+        }
+
+        static NavierStokesBase& level (Amr& amr, int lev)
+        {
+            return dynamic_cast<NavierStokesBase&>(amr.getLevel(lev));
+        }
+
+        void copy_level0 (Amr& amr, MultiFab& S, MultiFab& Pr) const
+        {
+            S.ParallelCopy(level(amr,0).get_new_data(State_Type), 0, 0, S.nComp());
+            Pr.ParallelCopy(level(amr,0).get_new_data(Press_Type), 0, 0, 1);
+        }
+
+        //
+        // Start the hierarchy from a level 0 state: the finer levels are
+        // interpolated from level 0 and regridded.
+        //
+        void replace_state (Amr& amr, Real time, const MultiFab& S, const MultiFab& Pr) const
+        {
+            amr.setCumTime(time);
+            for (int lev = 0; lev <= amr.finestLevel(); ++lev) {
+                level(amr,lev).setTimeLevel(time, amr.dtLevel(lev), amr.dtLevel(lev));
+            }
+
+            NavierStokesBase& ns0 = level(amr,0);
+            ns0.get_new_data(State_Type).ParallelCopy(S, 0, 0, S.nComp());
+            ns0.get_new_data(Press_Type).ParallelCopy(Pr, 0, 0, 1);
+            ns0.computeGradP(ns0.get_state_data(Press_Type).curTime());
+
+            for (int lev = 1; lev <= amr.finestLevel(); ++lev)
+            {
+                NavierStokesBase& ns   = level(amr,lev);
+                NavierStokesBase& crse = level(amr,lev-1);
+                ns.FillCoarsePatch(ns.get_new_data(State_Type), 0,
+                                   crse.get_state_data(State_Type).curTime(),
+                                   State_Type, 0, S.nComp());
+                ns.FillCoarsePatch(ns.get_new_data(Press_Type), 0,
+                                   crse.get_state_data(Press_Type).curTime(),
+                                   Press_Type, 0, 1);
+                ns.computeGradP(ns.get_state_data(Press_Type).curTime());
+            }
+
+            if (amr.maxLevel() > 0) {
+                amr.regrid(0, time);
+            }
+        }
+
+        //
+        // Set level 0 to S and add the change, injected, to the finer levels.
+        //
+        void correct_state (Amr& amr, const MultiFab& S) const
+        {
+            const int ncomp = S.nComp();
+            MultiFab& S0 = level(amr,0).get_new_data(State_Type);
+
+            MultiFab delta(S0.boxArray(), S0.DistributionMap(), ncomp, 0);
+            delta.ParallelCopy(S, 0, 0, ncomp);
+            MultiFab::Subtract(delta, S0, 0, 0, ncomp, 0);
+            MultiFab::Add(S0, delta, 0, 0, ncomp, 0);
+
+            IntVect rr(1);
+            for (int lev = 1; lev <= amr.finestLevel(); ++lev)
+            {
+                rr *= amr.refRatio(lev-1);
+                MultiFab& Sf = level(amr,lev).get_new_data(State_Type);
+
+                MultiFab cdelta(amrex::coarsen(Sf.boxArray(), rr), Sf.DistributionMap(), ncomp, 0);
+                cdelta.ParallelCopy(delta, 0, 0, ncomp);
+
+                const int rx = rr[0];
+                const int ry = rr[1];
+                const int rz = rr[AMREX_SPACEDIM-1];
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+                for (MFIter mfi(Sf,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+                {
+                    const Box& bx = mfi.tilebox();
+                    auto const& sf = Sf.array(mfi);
+                    auto const& cd = cdelta.const_array(mfi);
+                    amrex::ParallelFor(bx, ncomp, [=]
+                    AMREX_GPU_DEVICE (int i, int j, int k, int n) noexcept
+                    {
+                        sf(i,j,k,n) += cd(amrex::coarsen(i,rx), amrex::coarsen(j,ry),
+                                          (AMREX_SPACEDIM == 3) ? amrex::coarsen(k,rz) : k, n);
+                    });
+                }
+            }
+        }
+
+        //
+        // The first dt of a propagator run, from the current state and
+        // clipped to the end of the slice.
+        //
+        void reset_dt (Amr& amr, Real t_end) const
+        {
+            Real dt0 = t_end - amr.cumTime();
+            int  fac = 1;
+            for (int lev = 0; lev <= amr.finestLevel(); ++lev)
+            {
+                if (lev > 0) fac *= amr.nCycle(lev);
+                const Real est = (NavierStokesBase::fixed_dt > 0.0) ? NavierStokesBase::fixed_dt
+                                                                    : level(amr,lev).estTimeStep();
+                dt0 = std::min(dt0, fac*est);
+            }
+            fac = 1;
+            for (int lev = 0; lev <= amr.finestLevel(); ++lev)
+            {
+                if (lev > 0) fac *= amr.nCycle(lev);
+                amr.setDtLevel(dt0/fac, lev);
+            }
+        }
+
+        static void advance (Amr& amr, Real t_end, Real t_strt)
+        {
+            const Real eps = 1.e-8*(t_end - t_strt);
+            while (amr.okToContinue() && amr.cumTime() < t_end - eps) {
+                amr.coarseTimeStep(t_end);
+            }
+        }
+
+        void setup (Real strt_time, Real stop_time, int a_slice, int a_nslices, int a_group_size)
+        {
+            slice   = a_slice;
+            nslices = a_nslices;
+            group_size = a_group_size;
+            max_iter = nslices;
+
+            ParmParse pp("parareal");
+            pp.query("max_iter", max_iter);
+            pp.query("tol", tol);
+            pp.query("coarse_cfl", coarse_cfl);
+            pp.query("dir", dir);
+            max_iter = std::min(max_iter, nslices);
+
+            ParmParse ppamr("amr");
+            std::string restart;
+            ppamr.query("restart", restart);
+            if (!restart.empty()) {
+                amrex::Abort("parareal: runs start from the initial data, amr.restart is not supported");
+            }
+            ppamr.query("max_level", fine_max_level);
+            ppamr.query("check_file", check_file);
+            ppamr.query("file_name_digits", digits);
+            ppamr.add("plot_int", -1);
+            ppamr.add("check_int", -1);
+            ppamr.add("plot_per", -1.0);
+            ppamr.add("check_per", -1.0);
+            //
+            // Each group would write its own probes, slices, statistics
+            // and spectra.
+            //
+            NavierStokesBase::suspendDiagnostics(true);
+
+            t0 = strt_time + (stop_time - strt_time)*slice/nslices;
+            t1 = (slice == nslices-1) ? stop_time
+                                      : strt_time + (stop_time - strt_time)*(slice+1)/nslices;
+
+            if (ParallelDescriptor::IOProcessor()) {
+                if (!amrex::UtilCreateDirectory(dir, 0755)) {
+                    amrex::CreateDirectoryFailed(dir);
+                }
+            }
+            ParallelDescriptor::Barrier();
+
+            //
+            // The fine hierarchy at strt_time, on slice 0 only; the others
+            // just set up the EB geometry with it.
+            //
+            {
+                auto amr = make_amr(fine_max_level, std::string(), dir + "/F_init_chk");
+#ifdef AMREX_USE_EB
+                AmrLevel::SetEBSupportLevel(EBSupport::full);
+                AmrLevel::SetEBMaxGrowCells(5,5,5);
+                int max_coarsening_level = 100;
+                ParmParse().query("max_coarsening_level", max_coarsening_level);
+                initialize_EB2(amr->Geom(amr->maxLevel()), amr->maxLevel(), max_coarsening_level);
+#endif
+                int mgs = 32;
+                ppamr.query("max_grid_size", mgs);
+                ba = BoxArray(amr->Geom(0).Domain());
+                ba.maxSize(mgs);
+                Vector<int> pmap(ba.size());
+                for (int i = 0; i < ba.size(); ++i) {
+                    pmap[i] = i % ParallelDescriptor::NProcs();
+                }
+                dm = DistributionMapping(std::move(pmap));
+
+                const BoxArray nba = amrex::convert(ba, IntVect::TheNodeVector());
+                const int ncomp = NavierStokesBase::NUM_STATE;
+                const MFInfo info = MFInfo().SetArena(The_Pinned_Arena());
+                U.define (ba,  dm, ncomp, 0, info);
+                G.define (ba,  dm, ncomp, 0, info);
+                F.define (ba,  dm, ncomp, 0, info);
+                Un.define(ba,  dm, ncomp, 0, info);
+                P.define (nba, dm, 1,     0, info);
+                FP.define(nba, dm, 1,     0, info);
+                Pn.define(nba, dm, 1,     0, info);
+
+                if (slice == 0)
+                {
+                    amr->init(strt_time, stop_time);
+                    copy_level0(*amr, U, P);
+                    amr->checkPoint();
+                    init_file = amrex::Concatenate(dir + "/F_init_chk", amr->levelSteps(0), digits);
+                }
+            }
+
+            fine_cfl      = NavierStokesBase::cfl;
+            fine_fixed_dt = NavierStokesBase::fixed_dt;
+            if (coarse_cfl <= 0.0) coarse_cfl = fine_cfl;
+
+            if (NavierStokesBase::have_divu) {
+                amrex::Abort("parareal: a velocity divergence constraint (divu) is not supported");
+            }
+            if (NavierStokesBase::dt_control_active()) {
+                amrex::Abort("parareal: ns.dt_err_tol is not supported");
+            }
+            if (NavierStokesBase::delta_checkpoint_active()) {
+                amrex::Abort("parareal: ns.chk_full_interval > 1 is not supported");
+            }
+
+            //
+            // The level 0 hierarchy G restarts from.
+            //
+            const std::string base_root = dir + "/G_base_s" + std::to_string(slice) + "_chk";
+            auto amr = make_amr(0, std::string(), base_root);
+            amr->init(strt_time, stop_time);
+            amr->checkPoint();
+            base_file = amrex::Concatenate(base_root, amr->levelSteps(0), digits);
+        }
+
+        void run_coarse (const MultiFab& S, const MultiFab& Pr, MultiFab& Sout, MultiFab& Pout)
+        {
+            NavierStokesBase::cfl = coarse_cfl;
+            if (fine_fixed_dt > 0.0) {
+                NavierStokesBase::fixed_dt = fine_fixed_dt*coarse_cfl/fine_cfl;
+            }
+
+            auto amr = make_amr(0, base_file, dir + "/G_chk");
+            amr->init(t0, t1);
+            replace_state(*amr, t0, S, Pr);
+            reset_dt(*amr, t1);
+            advance(*amr, t1, t0);
+            copy_level0(*amr, Sout, Pout);
+
+            NavierStokesBase::cfl      = fine_cfl;
+            NavierStokesBase::fixed_dt = fine_fixed_dt;
+        }
+
+        //
+        // Restart the fine hierarchy at t0 for iteration iter, starting
+        // from U and P.
+        //
+        std::unique_ptr<Amr> fine_start (int iter, const std::string& root) const
+        {
+            std::unique_ptr<Amr> amr;
+            if (iter == 1 && slice > 0)
+            {
+                amr = make_amr(fine_max_level, base_file, root);
+                amr->init(t0, t1);
+                replace_state(*amr, t0, U, P);
+            }
+            else
+            {
+                const std::string file = (slice == 0)
+                    ? init_file
+                    : amrex::Concatenate(fine_root(iter-1, slice-1), int(prev_steps), digits);
+                amr = make_amr(fine_max_level, file, root);
+                amr->init(t0, t1);
+                correct_state(*amr, U);
+            }
+            return amr;
+        }
+
+        void run_fine (int iter)
+        {
+            auto amr = fine_start(iter, fine_root(iter, slice));
+            reset_dt(*amr, t1);
+            advance(*amr, t1, t0);
+            copy_level0(*amr, F, FP);
+            amr->checkPoint();
+            fine_steps = amr->levelSteps(0);
+            last_fine  = iter;
+
+            fine_files.resize(iter+1);
+            fine_files[iter] = amrex::Concatenate(fine_root(iter, slice), amr->levelSteps(0), digits);
+            amr.reset();
+
+            //
+            // The next slice restarted from the checkpoint of two iterations
+            // ago before the last convergence check.
+            //
+            if (iter > 2 && ParallelDescriptor::IOProcessor()) {
+                amrex::FileSystem::RemoveAll(fine_files[iter-2]);
+            }
+        }
+
+        //
+        // The end state and pressure, with the F checkpoint steps, go to
+        // the same rank of the next group.
+        //
+        void send_state (int iter) const
+        {
+            Vector<Real> buf{fine_steps};
+            for (MFIter mfi(Un); mfi.isValid(); ++mfi)
+            {
+                const FArrayBox& s = Un[mfi];
+                const FArrayBox& p = Pn[mfi];
+                buf.insert(buf.end(), s.dataPtr(), s.dataPtr()+s.size());
+                buf.insert(buf.end(), p.dataPtr(), p.dataPtr()+p.size());
+            }
+            const int dest = (slice+1)*group_size + ParallelDescriptor::MyProc();
+            MPI_Send(buf.data(), int(buf.size()), ParallelDescriptor::Mpi_typemap<Real>::type(),
+                     dest, iter, MPI_COMM_WORLD);
+        }
+
+        void recv_state (int iter)
+        {
+            std::size_t n = 1;
+            for (MFIter mfi(U); mfi.isValid(); ++mfi) {
+                n += U[mfi].size() + P[mfi].size();
+            }
+            Vector<Real> buf(n);
+            const int src = (slice-1)*group_size + ParallelDescriptor::MyProc();
+            MPI_Recv(buf.data(), int(n), ParallelDescriptor::Mpi_typemap<Real>::type(),
+                     src, iter, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+            prev_steps = buf[0];
+            const Real* b = buf.data() + 1;
+            for (MFIter mfi(U); mfi.isValid(); ++mfi)
+            {
+                FArrayBox& s = U[mfi];
+                FArrayBox& p = P[mfi];
+                std::copy(b, b+s.size(), s.dataPtr());
+                b += s.size();
+                std::copy(b, b+p.size(), p.dataPtr());
+                b += p.size();
+            }
+        }
+
+        //
+        // One G sweep; returns the local max of |change of U_n+1| and of
+        // |U_n+1| over the velocity components.
+        //
+        std::array<Real,2> sweep (int iter)
+        {
+            std::array<Real,2> r{0.0, 0.0};
+            if (slice < iter-1) return r;
+
+            const int ncomp = U.nComp();
+            MultiFab Unew(ba, dm, ncomp, 0, MFInfo().SetArena(The_Pinned_Arena()));
+
+            if (iter > 0 && slice == iter-1)
+            {
+                //
+                // U_n is converged, so is G(U_n).
+                //
+                MultiFab::Copy(Unew, F, 0, 0, ncomp, 0);
+                MultiFab::Copy(Pn, FP, 0, 0, 1, 0);
+            }
+            else
+            {
+                if (slice > 0) recv_state(iter);
+
+                MultiFab Gn (ba, dm, ncomp, 0, MFInfo().SetArena(The_Pinned_Arena()));
+                MultiFab GPn(P.boxArray(), dm, 1, 0, MFInfo().SetArena(The_Pinned_Arena()));
+                run_coarse(U, P, Gn, GPn);
+
+                MultiFab::Copy(Unew, Gn, 0, 0, ncomp, 0);
+                if (iter > 0)
+                {
+                    MultiFab::Add     (Unew, F, 0, 0, ncomp, 0);
+                    MultiFab::Subtract(Unew, G, 0, 0, ncomp, 0);
+                    MultiFab::Copy(Pn, FP, 0, 0, 1, 0);
+                }
+                else
+                {
+                    MultiFab::Copy(Pn, GPn, 0, 0, 1, 0);
+                }
+                MultiFab::Copy(G, Gn, 0, 0, ncomp, 0);
+            }
+
+            MultiFab::Subtract(Un, Unew, 0, 0, ncomp, 0);
+            for (int d = 0; d < AMREX_SPACEDIM; ++d)
+            {
+                r[0] = std::max(r[0], Un.norm0(Xvel+d, 0, true));
+                r[1] = std::max(r[1], Unew.norm0(Xvel+d, 0, true));
+            }
+            MultiFab::Copy(Un, Unew, 0, 0, ncomp, 0);
+
+            if (slice < nslices-1) send_state(iter);
+
+            return r;
+        }
+
+        void run ()
+        {
+            Un.setVal(0.0);
+            sweep(0);
+
+            for (int iter = 1; iter <= max_iter; ++iter)
+            {
+                if (slice >= iter-1) run_fine(iter);
+
+                std::array<Real,2> r = sweep(iter);
+                MPI_Allreduce(MPI_IN_PLACE, r.data(), 2, ParallelDescriptor::Mpi_typemap<Real>::type(),
+                              MPI_MAX, MPI_COMM_WORLD);
+                const Real change = r[0]/std::max(r[1], Real(1.e-30));
+
+                if (slice == 0) {
+                    amrex::Print() << "Parareal iteration " << iter
+                                   << ": max change of the slice end states = " << change << '\n';
+                }
+                if (change < tol) break;
+            }
+
+            //
+            // The final hierarchy, with the normal checkpoint name.
+            //
+            if (slice == nslices-1)
+            {
+                std::unique_ptr<Amr> amr;
+                if (last_fine < 0)
+                {
+                    amr = make_amr(fine_max_level, base_file, check_file);
+                    amr->init(t1, t1);
+                    replace_state(*amr, t1, Un, Pn);
+                }
+                else
+                {
+                    amr = make_amr(fine_max_level, fine_files[last_fine], check_file);
+                    amr->init(t1, t1);
+                    correct_state(*amr, Un);
+                }
+                amr->checkPoint();
+                amr->writePlotFile();
+            }
+        }
+    };
+}
+#endif
+
+//
+// parareal.nslices is needed before AMReX reads the inputs, so it is
+// taken from the command line only.
+//
+int
+parareal_nslices (int argc, char* argv[])
+{
+    const char*       key = "parareal.nslices=";
+    const std::size_t len = std::strlen(key);
+
+    int nslices = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], key, len) == 0) {
+            nslices = std::atoi(argv[i] + len);
+        }
+    }
+    return nslices;
+}
+
+void
+parareal_main (int argc, char* argv[], int nslices)
+{
+#ifdef AMREX_USE_MPI
+    MPI_Init(&argc, &argv);
+
+    int wrank, wsize;
+    MPI_Comm_rank(MPI_COMM_WORLD, &wrank);
+    MPI_Comm_size(MPI_COMM_WORLD, &wsize);
+
+    if (wsize % nslices != 0)
+    {
+        if (wrank == 0) {
+            std::fprintf(stderr, "parareal: the number of ranks (%d) must be a multiple of parareal.nslices (%d)\n",
+                         wsize, nslices);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    //
+    // Consecutive ranks form the group of a time slice.
+    //
+    const int group_size = wsize/nslices;
+    const int slice      = wrank/group_size;
+
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, slice, wrank, &comm);
+
+    amrex::Initialize(argc, argv, true, comm);
+    {
+        BL_PROFILE("parareal_main()");
+
+        const Real run_strt = ParallelDescriptor::second();
+
+        Real strt_time =  0.0;
+        Real stop_time = -1.0;
+        ParmParse pp;
+        pp.query("strt_time", strt_time);
+        pp.query("stop_time", stop_time);
+        if (stop_time <= strt_time) {
+            amrex::Abort("parareal: needs stop_time > strt_time");
+        }
+
+        Parareal pr;
+        pr.setup(strt_time, stop_time, slice, nslices, group_size);
+        pr.run();
+
+        Real run_time = ParallelDescriptor::second() - run_strt;
+        MPI_Allreduce(MPI_IN_PLACE, &run_time, 1, ParallelDescriptor::Mpi_typemap<Real>::type(),
+                      MPI_MAX, MPI_COMM_WORLD);
+        if (slice == 0) {
+            amrex::Print() << "Parareal run time = " << run_time << '\n';
+        }
+    }
+    amrex::Finalize();
+
+    MPI_Comm_free(&comm);
+    MPI_Finalize();
+#else
+    amrex::ignore_unused(nslices);
+    amrex::Initialize(argc, argv);
+    amrex::Abort("parareal.nslices > 1 needs an MPI build");
+#endif
+}
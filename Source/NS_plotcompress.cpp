@@ -0,0 +1,144 @@
+#include <NavierStokesBase.H>
+#include <PlotCompress.H>
+#include <AMReX_ParmParse.H>
+
+#include <map>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Error-bounded lossy compression of plotfiles
+//
+//    plot_compress.enable     = 1
+//    plot_compress.default    = rel 1.e-4
+//    plot_compress.x_velocity = abs 1.e-6
+//    plot_compress.tracer     = none
+//
+//  With enable, the level data of the plotfiles (see NS_plotfile.cpp)
+//  are written compressed by the codec of Utilities/PlotCompress.H
+//  instead of by VisMF: every plotted variable is reconstructed within
+//  its error bound, either absolute (abs) or relative to the range of the
+//  variable on the level (rel), or exactly (none). Each rank compresses
+//  its own grids, and the data files are shared by groups of ranks as
+//  with VisMF.
+//
+//  The plotfile Header is the usual one, except that the level data are
+//  named Level_n/CellZ. Such plotfiles are read by the compressed level
+//  reader plot_compress::read_level(), or turned back into regular
+//  plotfiles by Util/PlotfileCompress. Checkpoints are not affected.
+//---------------------------------------------------------------------
+
+namespace
+{
+    enum BoundKind { bound_none, bound_abs, bound_rel };
+
+    struct Bound
+    {
+        BoundKind kind  = bound_rel;
+        Real      value = 1.e-4;
+    };
+
+    int                          plot_compress_enable = 0;
+    Bound                        plot_compress_default;
+    std::map<std::string,Bound>  plot_compress_bound;
+
+    Bound read_bound (ParmParse& pp, const std::string& name)
+    {
+        Bound b;
+        std::string kind;
+        pp.get(name.c_str(), kind, 0);
+        if (kind == "none") {
+            b.kind = bound_none;
+            b.value = 0.0;
+            return b;
+        }
+        if (kind == "abs") {
+            b.kind = bound_abs;
+        } else if (kind == "rel") {
+            b.kind = bound_rel;
+        } else {
+            amrex::Abort("NavierStokesBase::read_plot_compress_params(): plot_compress." + name
+                         + " must be abs, rel or none");
+        }
+        pp.get(name.c_str(), b.value, 1);
+        if (b.value <= 0.0) {
+            amrex::Abort("NavierStokesBase::read_plot_compress_params(): plot_compress." + name
+                         + " needs a positive bound");
+        }
+        return b;
+    }
+
+    //
+    // The bound of a plotted variable, read on first use since the
+    // variables are only known after the parameters are read.
+    //
+    const Bound& bound_of (const std::string& name)
+    {
+        auto it = plot_compress_bound.find(name);
+        if (it == plot_compress_bound.end())
+        {
+            ParmParse pp("plot_compress");
+            const Bound b = pp.contains(name.c_str()) ? read_bound(pp, name)
+                                                      : plot_compress_default;
+            it = plot_compress_bound.emplace(name, b).first;
+        }
+        return it->second;
+    }
+}
+
+void
+NavierStokesBase::read_plot_compress_params ()
+{
+    ParmParse pp("plot_compress");
+
+    pp.query("enable", plot_compress_enable);
+
+    if (pp.contains("default")) {
+        plot_compress_default = read_bound(pp, "default");
+    }
+}
+
+bool
+NavierStokesBase::plot_compress_active ()
+{
+    return plot_compress_enable != 0;
+}
+
+void
+NavierStokesBase::write_compressed_level (const MultiFab& plotMF,
+                                          const Vector<std::string>& names,
+                                          const std::string& prefix)
+{
+    BL_PROFILE("NavierStokesBase::write_compressed_level()");
+
+    const int n_data_items = plotMF.nComp();
+
+    //
+    // Absolute error bounds; relative ones scale with the range of the
+    // variable on this level.
+    //
+    Vector<Real> eb(n_data_items, 0.0);
+    Vector<Real> range(2*n_data_items);
+    for (int n = 0; n < n_data_items; ++n)
+    {
+        range[2*n  ] =  plotMF.max(n, 0, true);
+        range[2*n+1] = -plotMF.min(n, 0, true);
+    }
+    ParallelDescriptor::ReduceRealMax(range.dataPtr(), range.size());
+
+    for (int n = 0; n < n_data_items; ++n)
+    {
+        const Bound& b = bound_of(names[n]);
+        if (b.kind == bound_abs) {
+            eb[n] = b.value;
+        } else if (b.kind == bound_rel) {
+            const Real vmax = range[2*n], vmin = -range[2*n+1];
+            Real scale = vmax - vmin;
+            if (scale <= 0.0) scale = std::max(std::abs(vmax), std::abs(vmin));
+            if (scale <= 0.0) scale = 1.0;
+            eb[n] = b.value*scale;
+        }
+    }
+
+    plot_compress::write_level(plotMF, names, eb, prefix);
+}
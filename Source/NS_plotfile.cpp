@@ -0,0 +1,332 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+#ifdef AMREX_USE_EB
+#include <AMReX_EB2.H>
+#endif
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Plotfile subsets
+//
+//    plotfile.region_lo = 0.5 0.0 0.0   # physical box to write
+//    plotfile.region_hi = 2.0 1.0 1.0
+//    plotfile.max_level = 1             # finest level to write
+//    plotfile.float32   = 1             # store the data in single precision
+//
+//  The variables are chosen as usual with amr.plot_vars and
+//  amr.derive_plot_vars. With a region, only the parts of the grids that
+//  intersect it are written, and the derived variables are only evaluated
+//  there (with EB they are evaluated on the whole level, once per plotfile,
+//  and the region copied out). Levels are written from 0 up to max_level, or up to the last
+//  level the region intersects. With float32, the FABs are written by
+//  VisMF as 32-bit native reals; readers convert them on input.
+//
+//  When none of these is set and plot_compress.enable is not set either
+//  (see NS_plotcompress.cpp), plotfiles are written by
+//  AmrLevel::writePlotFile().
+//---------------------------------------------------------------------
+
+namespace
+{
+    bool         plot_region = false;
+    Vector<Real> plot_region_lo;
+    Vector<Real> plot_region_hi;
+    int          plot_max_level = -1;
+    int          plot_float32 = 0;
+}
+
+void
+NavierStokesBase::read_plotfile_params ()
+{
+    ParmParse pp("plotfile");
+
+    pp.queryarr("region_lo", plot_region_lo);
+    pp.queryarr("region_hi", plot_region_hi);
+    pp.query("max_level", plot_max_level);
+    pp.query("float32",   plot_float32);
+
+    plot_region = !plot_region_lo.empty() || !plot_region_hi.empty();
+    if (plot_region)
+    {
+        if (plot_region_lo.size() != AMREX_SPACEDIM || plot_region_hi.size() != AMREX_SPACEDIM) {
+            amrex::Abort("NavierStokesBase::read_plotfile_params(): plotfile.region_lo and region_hi need AMREX_SPACEDIM values");
+        }
+        for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+            if (plot_region_hi[d] <= plot_region_lo[d]) {
+                amrex::Abort("NavierStokesBase::read_plotfile_params(): empty plotfile region");
+            }
+        }
+    }
+}
+
+//
+// The cells of level lev that the plotfile region covers.
+//
+Box
+NavierStokesBase::plot_region_box (int lev) const
+{
+    const Geometry& g = parent->Geom(lev);
+    if (!plot_region) {
+        return g.Domain();
+    }
+
+    IntVect lo, hi;
+    for (int d = 0; d < AMREX_SPACEDIM; ++d)
+    {
+        lo[d] = static_cast<int>(std::floor((plot_region_lo[d] - g.ProbLo(d))*g.InvCellSize(d)));
+        hi[d] = static_cast<int>(std::ceil ((plot_region_hi[d] - g.ProbLo(d))*g.InvCellSize(d))) - 1;
+    }
+    return Box(lo, hi) & g.Domain();
+}
+
+//
+// The finest level written to the plotfiles.
+//
+int
+NavierStokesBase::plot_finest_level () const
+{
+    int f_lev = parent->finestLevel();
+    if (plot_max_level >= 0) {
+        f_lev = std::min(f_lev, plot_max_level);
+    }
+    for (int lev = 0; lev <= f_lev; ++lev)
+    {
+        if (!parent->boxArray(lev).intersects(plot_region_box(lev))) {
+            return std::max(lev-1, 0);
+        }
+    }
+    return f_lev;
+}
+
+//
+// As AmrLevel::writePlotFile(), restricted to the plotfile region and
+// levels, with the level data written in single precision or compressed
+// if asked for.
+//
+void
+NavierStokesBase::writePlotFile (const std::string& dir,
+                                 std::ostream&      os,
+                                 VisMF::How         how)
+{
+    const bool compress = plot_compress_active();
+
+    if (!plot_region && plot_max_level < 0 && !plot_float32 && !compress)
+    {
+        AmrLevel::writePlotFile(dir, os, how);
+        return;
+    }
+
+    const int f_lev = plot_finest_level();
+    if (level > f_lev) return;
+
+    BL_PROFILE("NavierStokesBase::writePlotFile()");
+
+    //
+    // The state components (type, component) and derived variables
+    // to plot.
+    //
+    std::vector<std::pair<int,int>> plot_var_map;
+    for (int typ = 0; typ < desc_lst.size(); ++typ) {
+        for (int comp = 0; comp < desc_lst[typ].nComp(); ++comp) {
+            if (parent->isStatePlotVar(desc_lst[typ].name(comp)) &&
+                desc_lst[typ].getType() == IndexType::TheCellType())
+            {
+                plot_var_map.push_back(std::pair<int,int>(typ,comp));
+            }
+        }
+    }
+
+    Vector<std::string> derive_names;
+    for (const auto& d : derive_lst.dlist())
+    {
+        if (parent->isDerivePlotVar(d.name()))
+        {
+            derive_names.push_back(d.name());
+        }
+    }
+
+    Vector<std::string> names;
+    for (const auto& v : plot_var_map) {
+        names.push_back(desc_lst[v.first].name(v.second));
+    }
+    for (const auto& dname : derive_names) {
+        const DeriveRec* rec = derive_lst.get(dname);
+        for (int n = 0; n < rec->numDerive(); ++n) {
+            names.push_back(rec->variableName(n));
+        }
+    }
+    bool plot_vfrac = false;
+#ifdef AMREX_USE_EB
+    if (EB2::TopIndexSpaceIfPresent()) {
+        plot_vfrac = true;
+        names.push_back("vfrac");
+    }
+#endif
+    const int n_data_items = names.size();
+
+    const Real cur_time = state[0].curTime();
+
+    if (level == 0 && ParallelDescriptor::IOProcessor())
+    {
+        os << thePlotFileType() << '\n';
+
+        if (n_data_items == 0) {
+            amrex::Error("Must specify at least one valid data item to plot");
+        }
+
+        os << n_data_items << '\n';
+        for (const auto& name : names) {
+            os << name << '\n';
+        }
+
+        os << AMREX_SPACEDIM << '\n';
+        os << parent->cumTime() << '\n';
+        os << f_lev << '\n';
+        for (int i = 0; i < AMREX_SPACEDIM; ++i) {
+            os << Geom().ProbLo(i) << ' ';
+        }
+        os << '\n';
+        for (int i = 0; i < AMREX_SPACEDIM; ++i) {
+            os << Geom().ProbHi(i) << ' ';
+        }
+        os << '\n';
+        for (int i = 0; i < f_lev; ++i) {
+            os << parent->refRatio(i)[0] << ' ';
+        }
+        os << '\n';
+        for (int i = 0; i <= f_lev; ++i) {
+            os << parent->Geom(i).Domain() << ' ';
+        }
+        os << '\n';
+        for (int i = 0; i <= f_lev; ++i) {
+            os << parent->levelSteps(i) << ' ';
+        }
+        os << '\n';
+        for (int i = 0; i <= f_lev; ++i)
+        {
+            for (int k = 0; k < AMREX_SPACEDIM; ++k) {
+                os << parent->Geom(i).CellSize()[k] << ' ';
+            }
+            os << '\n';
+        }
+        os << (int) Geom().Coord() << '\n';
+        os << "0\n"; // Write bndry data.
+    }
+
+    //
+    // The parts of the grids in the region, on the ranks owning the grids.
+    //
+    const Box region = plot_region_box(level);
+    BoxList     bl;
+    Vector<int> owners;
+    for (int i = 0; i < grids.size(); ++i)
+    {
+        const Box isect = grids[i] & region;
+        if (isect.ok())
+        {
+            bl.push_back(isect);
+            owners.push_back(dmap[i]);
+        }
+    }
+    if (bl.isEmpty()) {
+        amrex::Abort("NavierStokesBase::writePlotFile(): the plotfile region misses level 0");
+    }
+    const BoxArray            plot_ba(std::move(bl));
+    const DistributionMapping plot_dm(std::move(owners));
+
+    const std::string sLevel = amrex::Concatenate("Level_", level, 1);
+    const std::string BaseName = compress ? "/CellZ" : "/Cell";
+    std::string FullPath = dir;
+    if (!FullPath.empty() && FullPath.back() != '/') {
+        FullPath += '/';
+    }
+    FullPath += sLevel;
+
+    if (!levelDirectoryCreated)
+    {
+        if (ParallelDescriptor::IOProcessor()) {
+            if (!amrex::UtilCreateDirectory(FullPath, 0755)) {
+                amrex::CreateDirectoryFailed(FullPath);
+            }
+        }
+        ParallelDescriptor::Barrier();
+    }
+
+    if (ParallelDescriptor::IOProcessor())
+    {
+        os << level << ' ' << plot_ba.size() << ' ' << cur_time << '\n';
+        os << parent->levelSteps(level) << '\n';
+
+        for (int i = 0; i < plot_ba.size(); ++i)
+        {
+            const RealBox gridloc(plot_ba[i], geom.CellSize(), geom.ProbLo());
+            for (int n = 0; n < AMREX_SPACEDIM; ++n) {
+                os << gridloc.lo(n) << ' ' << gridloc.hi(n) << '\n';
+            }
+        }
+        os << sLevel << BaseName << '\n';
+
+        if (plot_vfrac && level == f_lev) {
+            // volfrac threshold for amrvis
+            for (int lev = 0; lev <= f_lev; ++lev) {
+                os << "1.0e-6\n";
+            }
+        }
+    }
+
+    //
+    // All the plotted data in one MultiFab, in host accessible memory
+    // for the codec.
+    //
+    MFInfo info;
+    if (compress && Gpu::inLaunchRegion()) {
+        info.SetArena(The_Pinned_Arena());
+    }
+    MultiFab plotMF(plot_ba, plot_dm, n_data_items, 0, info);
+
+    int cnt = 0;
+    for (const auto& v : plot_var_map)
+    {
+        plotMF.ParallelCopy(state[v.first].newData(), v.second, cnt, 1);
+        ++cnt;
+    }
+    if (!derive_names.empty())
+    {
+        std::unique_ptr<MultiFab> derive_dat = derive_on_boxes(derive_names, cur_time,
+                                                               plot_ba, plot_dm);
+        MultiFab::Copy(plotMF, *derive_dat, 0, cnt, derive_dat->nComp(), 0);
+        cnt += derive_dat->nComp();
+    }
+#ifdef AMREX_USE_EB
+    if (plot_vfrac) {
+        plotMF.ParallelCopy(EBFactory().getVolFrac(), 0, cnt, 1);
+    }
+#endif
+    Gpu::streamSynchronize();
+
+    if (compress)
+    {
+        write_compressed_level(plotMF, names, FullPath + BaseName);
+    }
+    else
+    {
+        const FABio::Format format = FArrayBox::getFormat();
+        if (plot_float32) {
+            FArrayBox::setFormat(FABio::FAB_NATIVE_32);
+        }
+        VisMF::Write(plotMF, FullPath + BaseName, how, true);
+        FArrayBox::setFormat(format);
+    }
+
+    if (verbose)
+    {
+        amrex::Print() << "NavierStokesBase::writePlotFile(): lev: " << level
+                       << ", " << plot_ba.size() << " of " << grids.size() << " grids"
+                       << (compress ? ", compressed" : (plot_float32 ? ", float32" : ""))
+                       << '\n';
+    }
+
+    levelDirectoryCreated = false;
+}
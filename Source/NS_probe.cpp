@@ -0,0 +1,416 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Point and line probes
+//
+//    probe.int         = 1                       # sample every coarse step
+//    probe.points      = x0 y0 z0  x1 y1 z1      # any number of points
+//    probe.line_start  = x0 y0 z0                # any number of lines,
+//    probe.line_end    = x1 y1 z1                # each sampled by
+//    probe.line_npts   = 64                      # line_npts points
+//    probe.vars        = x_velocity avg_pressure # state or derived variables
+//    probe.file        = probes.csv
+//    probe.format      = csv                     # or binary
+//    probe.buffer_size = 100                     # samples kept before a flush
+//
+//  The level, grid and rank owning each probe are found once after each
+//  regrid. Every probe is attached to the finest level covering it and to a
+//  small box holding its (bi/tri)linear interpolation stencil. After the
+//  coarse step, the variables are evaluated on these boxes only, and all the
+//  probes of a level are interpolated in a single kernel.
+//
+//  Samples are buffered on the owning ranks and gathered to the IO processor,
+//  which appends them to the output file, every buffer_size samples, at
+//  checkpoints and at the end of the run. In the csv format each line is
+//  "step,time,probe,value,...", sorted by step then probe. The binary
+//  format has the same values as raw Reals, one record per line.
+//---------------------------------------------------------------------
+
+namespace
+{
+    Vector<RealVect>    probe_locs;
+    Vector<std::string> probe_vars;
+    int                 probe_ncomp = 0;
+    int                 probe_int   = 1;
+    int                 probe_buffer_size = 100;
+    std::string         probe_file("probes.csv");
+    std::string         probe_format("csv");
+
+    //
+    // Where the probes live; rebuilt after each regrid.
+    //
+    struct ProbeLevel
+    {
+        Vector<int>         ids;       // Probes attached to this level.
+        BoxArray            ba;        // One stencil box per probe.
+        DistributionMapping dm;        // Owner of the grid holding the probe.
+    };
+    Vector<ProbeLevel> probe_levels;
+    bool               probes_located = false;
+
+    //
+    // Local samples: step, time, probe id, then probe_ncomp values.
+    //
+    Vector<Real> probe_buffer;
+    int          probe_nbuffered = 0;
+}
+
+void
+NavierStokesBase::read_probe_params ()
+{
+    ParmParse pp("probe");
+
+    pp.query("int", probe_int);
+    pp.query("file", probe_file);
+    pp.query("format", probe_format);
+    pp.query("buffer_size", probe_buffer_size);
+    pp.queryarr("vars", probe_vars);
+
+    if (probe_format != "csv" && probe_format != "binary") {
+        amrex::Abort("NavierStokesBase::read_probe_params(): probe.format must be csv or binary");
+    }
+    probe_buffer_size = std::max(probe_buffer_size, 1);
+
+    Vector<Real> points;
+    pp.queryarr("points", points);
+    if (points.size() % AMREX_SPACEDIM != 0) {
+        amrex::Abort("NavierStokesBase::read_probe_params(): probe.points needs AMREX_SPACEDIM values per point");
+    }
+    for (int p = 0; p < points.size(); p += AMREX_SPACEDIM) {
+        probe_locs.push_back(RealVect(AMREX_D_DECL(points[p], points[p+1], points[p+2])));
+    }
+
+    Vector<Real> line_start, line_end;
+    Vector<int>  line_npts;
+    pp.queryarr("line_start", line_start);
+    pp.queryarr("line_end", line_end);
+    pp.queryarr("line_npts", line_npts);
+    const int nlines = line_start.size()/AMREX_SPACEDIM;
+    if (line_start.size() != line_end.size() ||
+        line_start.size() % AMREX_SPACEDIM != 0 ||
+        line_npts.size() != nlines)
+    {
+        amrex::Abort("NavierStokesBase::read_probe_params(): inconsistent probe.line_start, line_end and line_npts");
+    }
+    for (int l = 0; l < nlines; ++l)
+    {
+        const RealVect a(AMREX_D_DECL(line_start[AMREX_SPACEDIM*l],
+                                      line_start[AMREX_SPACEDIM*l+1],
+                                      line_start[AMREX_SPACEDIM*l+2]));
+        const RealVect b(AMREX_D_DECL(line_end[AMREX_SPACEDIM*l],
+                                      line_end[AMREX_SPACEDIM*l+1],
+                                      line_end[AMREX_SPACEDIM*l+2]));
+        const int n = std::max(line_npts[l], 2);
+        for (int i = 0; i < n; ++i) {
+            const Real s = Real(i)/Real(n-1);
+            probe_locs.push_back(a + s*(b - a));
+        }
+    }
+
+    if (!probe_locs.empty() && probe_vars.empty()) {
+        amrex::Abort("NavierStokesBase::read_probe_params(): probe.vars must be set");
+    }
+}
+
+bool
+NavierStokesBase::probe_sample_due (int step)
+{
+    return !probe_locs.empty() && probe_int > 0 && step % probe_int == 0;
+}
+
+void
+NavierStokesBase::invalidate_probe_locations ()
+{
+    probes_located = false;
+}
+
+//
+// Attach each probe to the finest level covering it.
+//
+void
+NavierStokesBase::locate_probes ()
+{
+    BL_PROFILE("NavierStokesBase::locate_probes()");
+
+    const int finest_level = parent->finestLevel();
+
+    probe_levels.clear();
+    probe_levels.resize(finest_level+1);
+
+    Vector<BoxList>          bls(finest_level+1);
+    Vector<Vector<int>>      owners(finest_level+1);
+
+    for (int p = 0; p < probe_locs.size(); ++p)
+    {
+        const RealVect& x = probe_locs[p];
+
+        for (int lev = finest_level; lev >= 0; --lev)
+        {
+            const Geometry& g   = parent->Geom(lev);
+            const Box&      dom = g.Domain();
+            const Real*     dx  = g.CellSize();
+
+            IntVect cell, stencil_lo;
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                const Real xi = (x[d] - g.ProbLo(d))/dx[d];
+                cell[d]       = static_cast<int>(std::floor(xi));
+                stencil_lo[d] = static_cast<int>(std::floor(xi - 0.5));
+            }
+            if (!dom.contains(cell)) {
+                if (lev == 0) {
+                    amrex::Abort("NavierStokesBase::locate_probes(): probe "
+                                 + std::to_string(p) + " is outside the domain");
+                }
+                continue;
+            }
+
+            const BoxArray& ba = parent->boxArray(lev);
+            std::vector<std::pair<int,Box>> isects = ba.intersections(Box(cell,cell), true, 0);
+            if (isects.empty()) continue;
+
+            //
+            // Two cells per direction, shifted back inside the domain.
+            //
+            Box stencil(stencil_lo, stencil_lo + IntVect::TheUnitVector());
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                if (stencil.smallEnd(d) < dom.smallEnd(d)) stencil.shift(d, dom.smallEnd(d) - stencil.smallEnd(d));
+                if (stencil.bigEnd(d)   > dom.bigEnd(d))   stencil.shift(d, dom.bigEnd(d)   - stencil.bigEnd(d));
+            }
+
+            probe_levels[lev].ids.push_back(p);
+            bls[lev].push_back(stencil);
+            owners[lev].push_back(parent->DistributionMap(lev)[isects[0].first]);
+            break;
+        }
+    }
+
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        if (!probe_levels[lev].ids.empty()) {
+            probe_levels[lev].ba = BoxArray(std::move(bls[lev]));
+            probe_levels[lev].dm = DistributionMapping(std::move(owners[lev]));
+        }
+    }
+
+    probes_located = true;
+}
+
+//
+// Called on level 0 once all levels have finished the coarse step.
+//
+void
+NavierStokesBase::sample_probes ()
+{
+    BL_PROFILE("NavierStokesBase::sample_probes()");
+
+    AMREX_ASSERT(level == 0);
+
+    if (!probes_located) {
+        locate_probes();
+    }
+
+    if (probe_ncomp == 0) {
+        for (const auto& name : probe_vars) {
+            probe_ncomp += derive_num_comp(name);
+        }
+    }
+
+    const int  finest_level = parent->finestLevel();
+    const Real time         = state[State_Type].curTime();
+    const int  step         = parent->levelSteps(0);
+    const int  ncomp        = probe_ncomp;
+    const int  rec_size     = 3 + ncomp;
+
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        const ProbeLevel& pl = probe_levels[lev];
+        if (pl.ids.empty()) continue;
+
+        std::unique_ptr<MultiFab> mf = getLevel(lev).derive_on_boxes(probe_vars, time, pl.ba, pl.dm);
+
+        const int nlocal = mf->local_size();
+        if (nlocal == 0) continue;
+
+        //
+        // Interpolation coordinates of the local probes, relative to the
+        // low corner of their stencil.
+        //
+        const Geometry& g = parent->Geom(lev);
+        Vector<GpuArray<Real,AMREX_SPACEDIM>> h_frac(nlocal);
+        Vector<int> h_ids(nlocal);
+        for (MFIter mfi(*mf); mfi.isValid(); ++mfi)
+        {
+            const int li = mfi.LocalIndex();
+            const int p  = pl.ids[mfi.index()];
+            const Box& bx = mfi.validbox();
+            h_ids[li] = p;
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                const Real xi = (probe_locs[p][d] - g.ProbLo(d))/g.CellSize(d) - 0.5
+                    - bx.smallEnd(d);
+                h_frac[li][d] = std::max(Real(0.0), std::min(Real(1.0), xi));
+            }
+        }
+
+        Gpu::DeviceVector<GpuArray<Real,AMREX_SPACEDIM>> d_frac(nlocal);
+        Gpu::copyAsync(Gpu::hostToDevice, h_frac.begin(), h_frac.end(), d_frac.begin());
+        Gpu::DeviceVector<Real> d_vals(nlocal*ncomp);
+
+        auto const& ma   = mf->const_arrays();
+        auto const* frac = d_frac.data();
+        Real*       vals = d_vals.data();
+
+        //
+        // One kernel for all the probes of this level.
+        //
+        amrex::ParallelFor(nlocal*ncomp, [=] AMREX_GPU_DEVICE (int m) noexcept
+        {
+            const int li = m / ncomp;
+            const int n  = m - li*ncomp;
+            auto const& a = ma[li];
+            const auto lo = amrex::lbound(a);
+            const auto& f = frac[li];
+            Real v = 0.0;
+#if (AMREX_SPACEDIM == 3)
+            for (int kk = 0; kk < 2; ++kk) {
+            const Real wz = kk ? f[2] : 1.0-f[2];
+#else
+            {
+            const int  kk = 0;
+            const Real wz = 1.0;
+#endif
+            for (int jj = 0; jj < 2; ++jj) {
+            const Real wy = jj ? f[1] : 1.0-f[1];
+            for (int ii = 0; ii < 2; ++ii) {
+                const Real wx = ii ? f[0] : 1.0-f[0];
+                v += wx*wy*wz*a(lo.x+ii, lo.y+jj, lo.z+kk, n);
+            }}}
+            vals[m] = v;
+        });
+
+        Vector<Real> h_vals(nlocal*ncomp);
+        Gpu::copyAsync(Gpu::deviceToHost, d_vals.begin(), d_vals.end(), h_vals.begin());
+        Gpu::streamSynchronize();
+
+        for (int li = 0; li < nlocal; ++li)
+        {
+            probe_buffer.push_back(static_cast<Real>(step));
+            probe_buffer.push_back(time);
+            probe_buffer.push_back(h_ids[li]);
+            for (int n = 0; n < ncomp; ++n) {
+                probe_buffer.push_back(h_vals[li*ncomp+n]);
+            }
+        }
+        AMREX_ASSERT(probe_buffer.size() % rec_size == 0);
+        amrex::ignore_unused(rec_size);
+    }
+
+    if (++probe_nbuffered >= probe_buffer_size) {
+        flush_probes();
+    }
+}
+
+//
+// Gather the buffered samples to the IO processor and append them.
+// Must be called by all the ranks.
+//
+void
+NavierStokesBase::flush_probes ()
+{
+    if (probe_locs.empty() || probe_nbuffered == 0) return;
+
+    BL_PROFILE("NavierStokesBase::flush_probes()");
+
+    const int IOProc   = ParallelDescriptor::IOProcessorNumber();
+    const int nprocs   = ParallelDescriptor::NProcs();
+    const int rec_size = 3 + probe_ncomp;
+
+    int mycount = probe_buffer.size();
+    Vector<int> counts(nprocs, 0);
+    ParallelDescriptor::Gather(&mycount, 1, counts.data(), 1, IOProc);
+
+    Vector<int> disps(nprocs, 0);
+    Long total = 0;
+    if (ParallelDescriptor::IOProcessor()) {
+        for (int i = 0; i < nprocs; ++i) {
+            disps[i] = total;
+            total += counts[i];
+        }
+    }
+    Vector<Real> all(ParallelDescriptor::IOProcessor() ? total : 0);
+    ParallelDescriptor::Gatherv(probe_buffer.data(), mycount, all.data(),
+                                counts, disps, IOProc);
+
+    if (ParallelDescriptor::IOProcessor())
+    {
+        const Long nrec = total/rec_size;
+        Vector<Long> order(nrec);
+        for (Long r = 0; r < nrec; ++r) order[r] = r;
+        std::sort(order.begin(), order.end(), [&all,rec_size] (Long a, Long b) {
+            const Real* ra = all.data() + a*rec_size;
+            const Real* rb = all.data() + b*rec_size;
+            return (ra[0] < rb[0]) || (ra[0] == rb[0] && ra[2] < rb[2]);
+        });
+
+        if (probe_format == "csv")
+        {
+            const bool new_file = !amrex::FileExists(probe_file);
+            std::ofstream ofs(probe_file, std::ios::out|std::ios::app);
+            if (!ofs.good()) {
+                amrex::FileOpenFailed(probe_file);
+            }
+            if (new_file)
+            {
+                //
+                // One column per component of the derived variables.
+                //
+                ofs << "step,time,probe";
+                for (const auto& name : probe_vars)
+                {
+                    int state_indx, comp;
+                    const DeriveRec* rec = isStateVariable(name, state_indx, comp)
+                                         ? nullptr : derive_lst.get(name);
+                    if (rec) {
+                        for (int n = 0; n < rec->numDerive(); ++n) {
+                            ofs << ',' << rec->variableName(n);
+                        }
+                    } else {
+                        ofs << ',' << name;
+                    }
+                }
+                ofs << '\n';
+            }
+            ofs << std::setprecision(15);
+            for (Long r : order)
+            {
+                const Real* rec = all.data() + r*rec_size;
+                ofs << static_cast<Long>(rec[0]) << ',' << rec[1] << ',' << static_cast<int>(rec[2]);
+                for (int n = 0; n < probe_ncomp; ++n) {
+                    ofs << ',' << rec[3+n];
+                }
+                ofs << '\n';
+            }
+        }
+        else
+        {
+            std::ofstream ofs(probe_file, std::ios::out|std::ios::app|std::ios::binary);
+            if (!ofs.good()) {
+                amrex::FileOpenFailed(probe_file);
+            }
+            for (Long r : order) {
+                ofs.write(reinterpret_cast<const char*>(all.data() + r*rec_size),
+                          rec_size*sizeof(Real));
+            }
+        }
+    }
+
+    probe_buffer.clear();
+    probe_nbuffered = 0;
+}
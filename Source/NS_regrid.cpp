@@ -0,0 +1,338 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_TagBox.H>
+
+#include <cstdint>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Adaptive regrid interval
+//
+//    ns.regrid_adaptive    = 1
+//    ns.regrid_safety      = 0.5    # fraction of the tag buffer features may cross
+//    ns.regrid_max_int     = 64     # most steps of a level between regrids
+//    ns.regrid_stable_tol  = 0.05   # tag change below which tags are stable
+//    ns.regrid_max_stretch = 8
+//    ns.regrid_skip_unchanged = 1
+//
+//  With regrid_adaptive, amr.regrid_int is the smallest interval between
+//  regrids (1 or 2 is a good choice) and a level is only regridded once
+//  the features tagged on it may have crossed regrid_safety times the tag
+//  buffer amr.n_error_buf, or after regrid_max_int steps.
+//
+//  The distance features may have moved since the last regrid of a level
+//  is bounded by the elapsed time divided by the time step estimate of
+//  estTimeStep (before the CFL factor), which is the time for the fastest
+//  velocity, or the largest acceleration, to carry anything one cell. The
+//  estimates of the finer levels, which move with the same flow, count
+//  too; a level without an estimate since its last regrid, or with an
+//  estimate of no motion, has moved nothing. This uses the estimates computeNewDt makes anyway, so the time
+//  step must not be fixed (ns.fixed_dt); with a fixed dt, every regrid is
+//  done as usual.
+//
+//  The tags are also compared from one regrid to the next, by their count
+//  and their centroid. When they barely changed, e.g. a refined region
+//  the flow goes through, the allowed travel is doubled, up to
+//  regrid_max_stretch times; when they changed, it is reset.
+//
+//  With regrid_skip_unchanged, before a regrid of a level, the levels
+//  from it up to the finest one that may get a finer level are tagged,
+//  and the regrid is skipped altogether when the tags and the grids of
+//  all these levels are the same as when they were last tagged: the new
+//  grids would be the same as well. The tags are compared through their
+//  count and two 31-bit hashes summed over the tagged cells, in the same
+//  single reduction as above. When the regrid is done, the tags are not
+//  computed again. When it is skipped, the level is not regridded, nor
+//  its tags checked again, before amr.regrid_int more steps, and the
+//  travel since its last actual regrid keeps counting.
+//
+//  All of this is forgotten when level 0 is initialized or restarted, so
+//  that a new hierarchy starts afresh.
+//---------------------------------------------------------------------
+
+namespace
+{
+    int  regrid_adaptive    = 0;
+    Real regrid_safety      = 0.5;
+    int  regrid_max_int     = 64;
+    Real regrid_stable_tol  = 0.05;
+    Real regrid_max_stretch = 8.0;
+    int  regrid_skip_unchanged = 0;
+
+    //
+    // Hashes of the index of a tagged cell, 31 bits each so that sums
+    // over up to 2^32 cells do not overflow.
+    //
+    AMREX_GPU_HOST_DEVICE AMREX_FORCE_INLINE
+    Long tag_hash (int i, int j, int k, std::uint64_t seed) noexcept
+    {
+        std::uint64_t x = ((std::uint64_t(i) & 0x1fffff) << 42)
+                        | ((std::uint64_t(j) & 0x1fffff) << 21)
+                        |  (std::uint64_t(k) & 0x1fffff);
+        x ^= seed;
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        x =  x ^ (x >> 31);
+        return static_cast<Long>(x & 0x7fffffff);
+    }
+
+    struct RegridState
+    {
+        Real last_time = -1.0;   // Time of the last regrid; < 0 if unknown.
+        int  last_step = 0;
+        Real rate      = 0.0;    // Largest cell rate since then, in cells/time.
+        Real stretch   = 1.0;
+        Real ntags     = -1.0;   // Tag count and centroid at the last tagging.
+        RealVect centroid;
+        Long hash[2]   = {0, 0};
+        BoxArray tag_ba;         // Grids and step of the last tagging.
+        int  tag_step  = -1;
+        bool tags_same = false;  // Whether it found the tags before it.
+        int  check_step = -1;    // Step of the last check for unchanged tags.
+    };
+
+    Vector<RegridState> regrid_state;
+
+    RegridState& regrid_level (int lev)
+    {
+        if (regrid_state.size() <= lev) {
+            regrid_state.resize(lev+1);
+        }
+        return regrid_state[lev];
+    }
+}
+
+void
+NavierStokesBase::read_regrid_params ()
+{
+    ParmParse pp("ns");
+
+    pp.query("regrid_adaptive",    regrid_adaptive);
+    pp.query("regrid_safety",      regrid_safety);
+    pp.query("regrid_max_int",     regrid_max_int);
+    pp.query("regrid_stable_tol",  regrid_stable_tol);
+    pp.query("regrid_max_stretch", regrid_max_stretch);
+    pp.query("regrid_skip_unchanged", regrid_skip_unchanged);
+
+    if (regrid_adaptive && (regrid_safety <= 0.0 || regrid_max_stretch < 1.0)) {
+        amrex::Abort("NavierStokesBase::read_regrid_params(): need regrid_safety > 0 and regrid_max_stretch >= 1");
+    }
+}
+
+//
+// Forget the regrid state of all levels, when a hierarchy is initialized
+// or restarted: several may be built one after the other in a run.
+//
+void
+NavierStokesBase::regrid_reset ()
+{
+    regrid_state.clear();
+}
+
+//
+// Record the time step estimates of all levels, before the CFL factor.
+//
+void
+NavierStokesBase::regrid_note_estimates (const Vector<Real>& estdt)
+{
+    if (!regrid_adaptive) return;
+
+    const int finest_level = parent->finestLevel();
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        RegridState& rs = regrid_level(lev);
+        const Real dx   = parent->Geom(lev).CellSize(0);
+        for (int k = lev; k <= finest_level; ++k)
+        {
+            if (estdt[k] < 1.0e+20) {
+                const Real r = parent->Geom(k).CellSize(0)/(dx*estdt[k]);
+                rs.rate = std::max(rs.rate, r);
+            }
+        }
+    }
+}
+
+int
+NavierStokesBase::okToRegrid ()
+{
+    if (regrid_adaptive && fixed_dt <= 0.0)
+    {
+        RegridState& rs  = regrid_level(level);
+        const Real  time = state[State_Type].curTime();
+        const int   step = parent->levelSteps(level);
+
+        //
+        // Without an estimate since the last regrid, e.g. right after it or
+        // in a flow at rest, nothing is known to have moved.
+        //
+        bool regrid = rs.last_time < 0.0;
+
+        const Real travel = (time - rs.last_time)*rs.rate;
+        const Real allowed = regrid_safety*rs.stretch*parent->nErrorBuf(level);
+        regrid = regrid || travel >= allowed || step - rs.last_step >= regrid_max_int;
+
+        if (verbose)
+        {
+            amrex::Print() << "NavierStokesBase::okToRegrid(): lev: " << level
+                           << ", travel: " << travel << " of " << allowed << " cells"
+                           << (regrid ? ", regrid" : "") << '\n';
+        }
+
+        if (!regrid) return false;
+    }
+
+    if (regrid_skip_unchanged)
+    {
+        //
+        // After a skip, the tags are looked at again only once the regrid
+        // interval has passed since, as Amr asks again on each step.
+        //
+        RegridState& rs = regrid_level(level);
+        const int   step = parent->levelSteps(level);
+        if (rs.check_step >= 0 && step >= rs.check_step &&
+            step - rs.check_step < std::max(parent->regridInt(level), 1)) {
+            return false;
+        }
+        rs.check_step = step;
+
+        if (regrid_tags_unchanged())
+        {
+            if (verbose)
+            {
+                amrex::Print() << "NavierStokesBase::okToRegrid(): lev: " << level
+                               << ", tags unchanged, regrid skipped\n";
+            }
+            return false;
+        }
+    }
+
+    if (regrid_adaptive && fixed_dt <= 0.0)
+    {
+        //
+        // The finer levels get new grids as well.
+        //
+        const Real time = state[State_Type].curTime();
+        for (int lev = level; lev <= parent->maxLevel(); ++lev)
+        {
+            RegridState& r = regrid_level(lev);
+            r.last_time = time;
+            r.last_step = parent->levelSteps(std::min(lev, parent->finestLevel()));
+            r.rate      = 0.0;
+        }
+    }
+    return true;
+}
+
+//
+// Tag the levels the regrid of this level would tag, and tell whether
+// their tags and grids are all the same as at their last tagging.
+//
+bool
+NavierStokesBase::regrid_tags_unchanged ()
+{
+    BL_PROFILE("NavierStokesBase::regrid_tags_unchanged()");
+
+    const int max_crse = std::min(parent->finestLevel(), parent->maxLevel()-1);
+    for (int lev = level; lev <= max_crse; ++lev)
+    {
+        NavierStokesBase& ns_level = getLevel(lev);
+        TagBoxArray tags(ns_level.boxArray(), ns_level.DistributionMap(), parent->nErrorBuf(lev));
+        ns_level.errorEst(tags, TagBox::CLEAR, TagBox::SET,
+                          ns_level.get_state_data(State_Type).curTime(), parent->nErrorBuf(lev), 0);
+        //
+        // The levels left are tagged by the regrid.
+        //
+        if (!regrid_level(lev).tags_same) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Compare the tags with those of the last tagging of this level, and
+// stretch or reset the allowed travel. The same tags are only looked at
+// once per step.
+//
+void
+NavierStokesBase::regrid_track_tags (const TagBoxArray& tags, int tagval)
+{
+    if (!regrid_adaptive && !regrid_skip_unchanged) return;
+
+    RegridState& rs = regrid_level(level);
+    const int step  = parent->levelSteps(level);
+    if (rs.tag_step == step && rs.tag_ba == tags.boxArray()) return;
+
+    BL_PROFILE("NavierStokesBase::regrid_track_tags()");
+
+    //
+    // Sums of the indices, count and hashes of the tagged cells, all
+    // integers.
+    //
+    ReduceOps<AMREX_D_DECL(ReduceOpSum,ReduceOpSum,ReduceOpSum),
+              ReduceOpSum,ReduceOpSum,ReduceOpSum> reduce_op;
+    ReduceData<AMREX_D_DECL(Long,Long,Long),Long,Long,Long> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
+    const char tv = static_cast<char>(tagval);
+    for (MFIter mfi(tags); mfi.isValid(); ++mfi)
+    {
+        const Box& bx = mfi.validbox();
+        auto const& t = tags.const_array(mfi);
+        reduce_op.eval(bx, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i, int j, int k) noexcept -> ReduceTuple
+        {
+            if (t(i,j,k) != tv) {
+                return { AMREX_D_DECL(Long(0), Long(0), Long(0)), Long(0), Long(0), Long(0) };
+            }
+            return { AMREX_D_DECL(Long(i), Long(j), Long(k)), Long(1),
+                     tag_hash(i,j,k,0x243f6a8885a308d3ULL), tag_hash(i,j,k,0x13198a2e03707344ULL) };
+        });
+    }
+
+    ReduceTuple hv = reduce_data.value(reduce_op);
+    Long s[AMREX_SPACEDIM+3] = { AMREX_D_DECL(amrex::get<0>(hv), amrex::get<1>(hv), amrex::get<2>(hv)),
+                                 amrex::get<AMREX_SPACEDIM>(hv),
+                                 amrex::get<AMREX_SPACEDIM+1>(hv),
+                                 amrex::get<AMREX_SPACEDIM+2>(hv) };
+    ParallelDescriptor::ReduceLongSum(s, AMREX_SPACEDIM+3);
+
+    const Real ntags = static_cast<Real>(s[AMREX_SPACEDIM]);
+    RealVect centroid;
+    for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+        centroid[d] = (ntags > 0.0) ? s[d]/ntags : 0.0;
+    }
+
+    rs.tags_same = rs.ntags == ntags && rs.hash[0] == s[AMREX_SPACEDIM+1]
+                && rs.hash[1] == s[AMREX_SPACEDIM+2] && rs.tag_ba == tags.boxArray();
+
+    if (regrid_adaptive && rs.ntags >= 0.0)
+    {
+        //
+        // Relative change of the count, plus the shift of the centroid
+        // relative to the tag buffer.
+        //
+        Real shift = 0.0;
+        for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+            shift = std::max(shift, std::abs(centroid[d] - rs.centroid[d]));
+        }
+        const Real change = std::abs(ntags - rs.ntags)/std::max(rs.ntags, Real(1.0))
+                          + shift/std::max(parent->nErrorBuf(level), 1);
+
+        rs.stretch = (change < regrid_stable_tol) ? std::min(2.0*rs.stretch, regrid_max_stretch)
+                                                  : 1.0;
+        if (verbose)
+        {
+            amrex::Print() << "NavierStokesBase::regrid_track_tags(): lev: " << level
+                           << ", tag change: " << change << ", stretch: " << rs.stretch << '\n';
+        }
+    }
+    rs.ntags    = ntags;
+    rs.centroid = centroid;
+    rs.hash[0]  = s[AMREX_SPACEDIM+1];
+    rs.hash[1]  = s[AMREX_SPACEDIM+2];
+    rs.tag_ba   = tags.boxArray();
+    rs.tag_step = step;
+}
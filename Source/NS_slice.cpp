@@ -0,0 +1,460 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// In-situ slice output
+//
+//  Axis-aligned planes (lines in 2D) of state and derived variables are
+//  written at their own cadence, independently of the plotfiles:
+//
+//    slice.int    = 10                 # every 10 coarse steps, and/or
+//    slice.per    = 0.01               # every 0.01 time units
+//    slice.normal = 2 0                # normal direction of each plane
+//    slice.coord  = 0.5 0.25           # physical location of each plane
+//    slice.names  = zmid xquarter      # optional, default plane0 plane1 ...
+//    slice.vars   = x_velocity mag_vort
+//    slice.dir    = SLICES             # output directory
+//
+//  All AMR levels are composited onto the plane at the resolution of the
+//  finest level, finer data overwriting coarser data. Each plane is a single
+//  time-series file <dir>/<name>.bin to which every rank writes its own part
+//  of each record, with the record layout described in <dir>/<name>.hdr:
+//  one line per record with the step, the time, the finest level, the plane
+//  box, the number of components and the byte offset of the record. Within
+//  a record, data are stored as ncomp blocks of the plane in Fortran order.
+//
+//  Checkpoints hold the end of each data file, in SliceOffsets. On restart,
+//  the records written after that checkpoint are dropped from the data and
+//  header files, so that the steps run again are not stored twice.
+//
+//  The former ns.dump_plane = k is mapped onto a plane normal to the last
+//  direction through the k-th cell of level 0, written every step.
+//---------------------------------------------------------------------
+
+namespace
+{
+    struct SlicePlane
+    {
+        std::string name;
+        int         normal = AMREX_SPACEDIM-1;
+        Real        coord  = 0.0;
+        int         index0 = -1;   // Level 0 cell index; overrides coord if >= 0.
+        Long        offset = -1;   // End of the data file; -1 until first written.
+    };
+
+    Vector<SlicePlane>  slice_planes;
+    Vector<std::string> slice_vars;
+    int                 slice_int = -1;
+    Real                slice_per = -1.0;
+    std::string         slice_dir("SLICES");
+}
+
+void
+NavierStokesBase::read_slice_params ()
+{
+    ParmParse pp("slice");
+
+    pp.query("int", slice_int);
+    pp.query("per", slice_per);
+    pp.query("dir", slice_dir);
+
+    Vector<int>  normal;
+    Vector<Real> coord;
+    Vector<std::string> names;
+    pp.queryarr("normal", normal);
+    pp.queryarr("coord", coord);
+    pp.queryarr("names", names);
+    pp.queryarr("vars", slice_vars);
+
+    if (normal.size() != coord.size()) {
+        amrex::Abort("NavierStokesBase::read_slice_params(): slice.normal and slice.coord must have the same length");
+    }
+    if (!names.empty() && names.size() != normal.size()) {
+        amrex::Abort("NavierStokesBase::read_slice_params(): slice.names must have one entry per plane");
+    }
+
+    for (int p = 0; p < normal.size(); ++p)
+    {
+        if (normal[p] < 0 || normal[p] >= AMREX_SPACEDIM) {
+            amrex::Abort("NavierStokesBase::read_slice_params(): slice.normal must be in [0,AMREX_SPACEDIM)");
+        }
+        SlicePlane sp;
+        sp.name   = names.empty() ? "plane" + std::to_string(p) : names[p];
+        sp.normal = normal[p];
+        sp.coord  = coord[p];
+        slice_planes.push_back(sp);
+    }
+
+    //
+    // Backward compatibility with ns.dump_plane.
+    //
+    ParmParse ppns("ns");
+    int dump_plane = -1;
+    ppns.query("dump_plane", dump_plane);
+    if (dump_plane >= 0)
+    {
+        SlicePlane sp;
+        sp.name   = "dump_plane";
+        sp.normal = AMREX_SPACEDIM-1;
+        sp.index0 = dump_plane;
+        slice_planes.push_back(sp);
+
+        if (slice_int <= 0 && slice_per <= 0.0) {
+            slice_int = 1;
+        }
+        if (slice_vars.empty()) {
+            slice_vars = {AMREX_D_DECL("x_velocity", "y_velocity", "z_velocity")};
+        }
+    }
+
+    if (!slice_planes.empty() && slice_vars.empty()) {
+        amrex::Abort("NavierStokesBase::read_slice_params(): slice.vars must be set");
+    }
+}
+
+bool
+NavierStokesBase::slice_output_due (int step, Real time, Real dt)
+{
+    if (slice_planes.empty()) {
+        return false;
+    }
+
+    bool due = false;
+    if (slice_int > 0 && step % slice_int == 0) {
+        due = true;
+    }
+    if (slice_per > 0.0 &&
+        static_cast<Long>(std::floor(time/slice_per)) > static_cast<Long>(std::floor((time-dt)/slice_per)))
+    {
+        due = true;
+    }
+    return due;
+}
+
+//
+// Called on level 0 once all levels have finished the coarse step.
+//
+void
+NavierStokesBase::write_slices ()
+{
+    BL_PROFILE("NavierStokesBase::write_slices()");
+
+    AMREX_ASSERT(level == 0);
+
+    const Real strt_time = ParallelDescriptor::second();
+
+    const int  finest_level = parent->finestLevel();
+    const Real time         = state[State_Type].curTime();
+    const int  step         = parent->levelSteps(0);
+
+    const Geometry& fgeom = parent->Geom(finest_level);
+
+    int ncomp = 0;
+    for (const auto& name : slice_vars) {
+        ncomp += derive_num_comp(name);
+    }
+
+    if (ParallelDescriptor::IOProcessor()) {
+        if (!amrex::UtilCreateDirectory(slice_dir, 0755)) {
+            amrex::CreateDirectoryFailed(slice_dir);
+        }
+    }
+    ParallelDescriptor::Barrier();
+
+    for (auto& sp : slice_planes)
+    {
+        const int nd = sp.normal;
+
+        Real coord = sp.coord;
+        if (sp.index0 >= 0) {
+            coord = geom.ProbLo(nd) + (sp.index0 + 0.5)*geom.CellSize(nd);
+        }
+
+        //
+        // Plane at the resolution of the finest level.
+        //
+        auto plane_index = [coord,nd] (const Geometry& g) {
+            const Box& dom = g.Domain();
+            int k = static_cast<int>(std::floor((coord - g.ProbLo(nd))/g.CellSize(nd)));
+            return std::max(dom.smallEnd(nd), std::min(dom.bigEnd(nd), k));
+        };
+
+        Box pbox = fgeom.Domain();
+        const int kf = plane_index(fgeom);
+        pbox.setSmall(nd, kf);
+        pbox.setBig  (nd, kf);
+
+        BoxArray pba(pbox);
+        pba.maxSize(parent->maxGridSize(finest_level));
+        DistributionMapping pdm{pba};
+
+        MultiFab plane(pba, pdm, ncomp, 0);
+        plane.setVal(0.0);
+
+        //
+        // Levels are visited from coarse to fine so that finer data
+        // overwrite coarser data in the composite.
+        //
+        for (int lev = 0; lev <= finest_level; ++lev)
+        {
+            NavierStokesBase& ns_level = getLevel(lev);
+
+            IntVect ratio = IntVect::TheUnitVector();
+            for (int l = lev; l < finest_level; ++l) {
+                ratio *= parent->refRatio(l);
+            }
+
+            //
+            // The coarse cells under the fine plane, so that the injection
+            // below only reads inside the derived region.
+            //
+            const Box region = amrex::coarsen(pbox, ratio);
+
+            std::unique_ptr<MultiFab> crse = ns_level.derive_on_region(slice_vars, time, region);
+
+            if (!crse) continue;
+
+            //
+            // Inject onto the finest resolution, keeping the owners.
+            //
+            BoxList fbl;
+            for (int i = 0; i < crse->boxArray().size(); ++i) {
+                Box b = amrex::refine(crse->boxArray()[i], ratio);
+                b.setSmall(nd, kf);
+                b.setBig  (nd, kf);
+                fbl.push_back(b);
+            }
+            MultiFab fine(BoxArray(std::move(fbl)), crse->DistributionMap(), ncomp, 0);
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+            for (MFIter mfi(fine,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+            {
+                const Box& bx = mfi.tilebox();
+                auto const& f = fine.array(mfi);
+                auto const& c = crse->const_array(mfi);
+                amrex::ParallelFor(bx, ncomp, [f,c,ratio]
+                AMREX_GPU_DEVICE (int i, int j, int kk, int n) noexcept
+                {
+                    IntVect iv(AMREX_D_DECL(i,j,kk));
+                    f(iv,n) = c(amrex::coarsen(iv,ratio),n);
+                });
+            }
+
+            plane.ParallelCopy(fine, 0, 0, ncomp);
+        }
+
+        //
+        // Append the record. Every rank writes its own boxes.
+        //
+        const std::string data_file = slice_dir + "/" + sp.name + ".bin";
+        const std::string hdr_file  = slice_dir + "/" + sp.name + ".hdr";
+
+        int d0 = (nd == 0) ? 1 : 0;
+#if (AMREX_SPACEDIM == 3)
+        int d1 = (nd == 2) ? 1 : 2;
+        const Long n1 = pbox.length(d1);
+#else
+        const Long n1 = 1;
+#endif
+        const Long n0 = pbox.length(d0);
+        const Long record_size = n0*n1*ncomp*static_cast<Long>(sizeof(Real));
+
+        if (sp.offset < 0)
+        {
+            if (ParallelDescriptor::IOProcessor())
+            {
+                std::ifstream is(data_file, std::ios::in|std::ios::binary|std::ios::ate);
+                sp.offset = is.good() ? static_cast<Long>(is.tellg()) : 0;
+                is.close();
+
+                if (sp.offset == 0)
+                {
+                    std::ofstream hdr(hdr_file, std::ios::out|std::ios::trunc);
+                    if (!hdr.good()) {
+                        amrex::FileOpenFailed(hdr_file);
+                    }
+                    hdr << "normal " << nd << " coord " << coord << " ncomp " << ncomp << " vars";
+                    for (const auto& name : slice_vars) {
+                        hdr << ' ' << name;
+                    }
+                    hdr << '\n';
+                }
+            }
+            ParallelDescriptor::Bcast(&sp.offset, 1, ParallelDescriptor::IOProcessorNumber());
+        }
+
+        // Make sure the file exists before every rank opens it for update.
+        if (ParallelDescriptor::IOProcessor())
+        {
+            std::ofstream ofs(data_file, std::ios::out|std::ios::app|std::ios::binary);
+            if (!ofs.good()) {
+                amrex::FileOpenFailed(data_file);
+            }
+        }
+        ParallelDescriptor::Barrier();
+
+        if (plane.local_size() > 0)
+        {
+            std::fstream fs(data_file, std::ios::in|std::ios::out|std::ios::binary);
+            if (!fs.good()) {
+                amrex::FileOpenFailed(data_file);
+            }
+
+            Vector<Real> row;
+            for (MFIter mfi(plane); mfi.isValid(); ++mfi)
+            {
+                const Box& bx = mfi.validbox();
+                FArrayBox hfab(bx, ncomp, The_Pinned_Arena());
+                hfab.copy<RunOn::Device>(plane[mfi], bx, 0, bx, 0, ncomp);
+                Gpu::streamSynchronize();
+
+                const int len = bx.length(d0);
+                row.resize(len);
+
+                Box rows = bx;
+                rows.setBig(d0, bx.smallEnd(d0));
+                for (int n = 0; n < ncomp; ++n)
+                {
+                    for (IntVect iv = rows.smallEnd(); iv <= rows.bigEnd(); rows.next(iv))
+                    {
+                        IntVect jv = iv;
+                        for (int m = 0; m < len; ++m) {
+                            jv[d0] = iv[d0] + m;
+                            row[m] = hfab(jv, n);
+                        }
+#if (AMREX_SPACEDIM == 3)
+                        const Long j1 = iv[d1] - pbox.smallEnd(d1);
+#else
+                        const Long j1 = 0;
+#endif
+                        const Long j0 = iv[d0] - pbox.smallEnd(d0);
+                        const Long pos = sp.offset
+                            + ((static_cast<Long>(n)*n1 + j1)*n0 + j0)*static_cast<Long>(sizeof(Real));
+                        fs.seekp(pos);
+                        fs.write(reinterpret_cast<const char*>(row.data()), len*sizeof(Real));
+                    }
+                }
+            }
+            if (!fs.good()) {
+                amrex::Abort("NavierStokesBase::write_slices(): failed writing " + data_file);
+            }
+        }
+        ParallelDescriptor::Barrier();
+
+        if (ParallelDescriptor::IOProcessor())
+        {
+            std::ofstream hdr(hdr_file, std::ios::out|std::ios::app);
+            hdr << std::setprecision(15)
+                << step << ' ' << time << ' ' << finest_level << ' '
+                << pbox << ' ' << ncomp << ' ' << sp.offset << '\n';
+        }
+
+        sp.offset += record_size;
+    }
+
+    if (verbose)
+    {
+        const int IOProc = ParallelDescriptor::IOProcessorNumber();
+        Real run_time = ParallelDescriptor::second() - strt_time;
+        ParallelDescriptor::ReduceRealMax(run_time,IOProc);
+        amrex::Print() << "NavierStokesBase::write_slices(): wrote " << slice_planes.size()
+                       << " slice(s) at time " << time << " in " << run_time << " s\n";
+    }
+}
+
+//
+// The end of the data file of each plane, written along with the
+// checkpoint on level 0.
+//
+void
+NavierStokesBase::slice_checkpoint (const std::string& dir)
+{
+    if (slice_planes.empty() || !ParallelDescriptor::IOProcessor()) return;
+
+    std::ofstream ofs(dir + "/SliceOffsets", std::ios::out|std::ios::trunc);
+    if (!ofs.good()) {
+        amrex::FileOpenFailed(dir + "/SliceOffsets");
+    }
+    for (const auto& sp : slice_planes)
+    {
+        Long offset = sp.offset;
+        if (offset < 0)
+        {
+            std::ifstream is(slice_dir + "/" + sp.name + ".bin", std::ios::in|std::ios::binary|std::ios::ate);
+            offset = is.good() ? static_cast<Long>(is.tellg()) : 0;
+        }
+        ofs << sp.name << ' ' << offset << '\n';
+    }
+}
+
+//
+// Cut the data and header files of each plane back to the end recorded
+// in the checkpoint the run restarts from.
+//
+void
+NavierStokesBase::slice_restart (const std::string& dir)
+{
+    if (slice_planes.empty() || !amrex::FileExists(dir + "/SliceOffsets")) return;
+
+    Vector<char> fileCharPtr;
+    ParallelDescriptor::ReadAndBcastFile(dir + "/SliceOffsets", fileCharPtr);
+    std::istringstream is(std::string(fileCharPtr.dataPtr()));
+
+    std::string name;
+    Long        offset;
+    while (is >> name >> offset)
+    {
+        for (auto& sp : slice_planes)
+        {
+            if (sp.name != name) continue;
+
+            const std::string data_file = slice_dir + "/" + sp.name + ".bin";
+            const std::string hdr_file  = slice_dir + "/" + sp.name + ".hdr";
+
+            if (ParallelDescriptor::IOProcessor() && amrex::FileExists(data_file))
+            {
+                if (static_cast<Long>(std::filesystem::file_size(data_file)) > offset) {
+                    std::filesystem::resize_file(data_file, offset);
+                }
+
+                //
+                // Keep the first line and the records before offset.
+                //
+                std::vector<std::string> lines;
+                {
+                    std::ifstream hdr(hdr_file);
+                    std::string line;
+                    while (std::getline(hdr, line))
+                    {
+                        std::istringstream ls(line);
+                        std::string field, last;
+                        while (ls >> field) last = field;
+                        if (lines.empty() || (!last.empty() && std::stol(last) < offset)) {
+                            lines.push_back(line);
+                        }
+                    }
+                }
+                std::ofstream hdr(hdr_file, std::ios::out|std::ios::trunc);
+                for (const auto& line : lines) {
+                    hdr << line << '\n';
+                }
+            }
+
+            //
+            // An empty file gets its header line again on the first write.
+            //
+            sp.offset = (offset > 0) ? offset : -1;
+        }
+    }
+    ParallelDescriptor::Barrier();
+}
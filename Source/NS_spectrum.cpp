@@ -0,0 +1,349 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_Utility.H>
+
+#include <complex>
+#include <fstream>
+#include <map>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// In-situ energy spectra
+//
+//  For fully periodic runs, the kinetic energy spectrum and the spectra of
+//  some scalars are computed on level 0 every spectrum.int coarse steps and
+//  appended to a single time-series file:
+//
+//    spectrum.int     = 10
+//    spectrum.scalars = tracer
+//    spectrum.file    = spectrum.dat
+//
+//  The level 0 data (onto which the finer levels are averaged down) are
+//  transformed with a slab/pencil distributed FFT: the field is copied into
+//  slabs normal to the last direction, transformed in the other directions,
+//  copied into pencils along the last direction and transformed there. The
+//  3D spectra are then shell-averaged into E(k), k = 0 .. up to the corner
+//  of the wavenumber box (about sqrt(3) n/2 in 3D), in units of 2 pi / L_x,
+//  with
+//
+//    E(k) = 1/2 sum_{k-1/2 <= |k'| < k+1/2} |u_hat(k')|^2
+//
+//  so that sum_k E(k) is the volume-averaged kinetic energy (for the
+//  velocity) or half the mean square (for a scalar). The shells beyond
+//  the smallest n/2 are only partly filled by the box of resolved modes.
+//
+//  Lengths that are not powers of two (e.g. 384 or 768) use Bluestein's
+//  algorithm, so every transform is O(n log n).
+//
+//  Each sample is one line of the file: step, time, then E(k) for the
+//  kinetic energy followed by E(k) for each scalar.
+//---------------------------------------------------------------------
+
+namespace
+{
+    using cplx = std::complex<Real>;
+
+    int                 spectrum_int = -1;
+    Vector<std::string> spectrum_scalars;
+    std::string         spectrum_file("spectrum.dat");
+
+    //
+    // Twiddle factors of a transform of length n, computed once per length.
+    // Lengths that are not powers of two go through Bluestein's algorithm:
+    // a convolution with a chirp, done with power-of-two transforms of
+    // length m >= 2n-1, whose transformed chirp is kept as well.
+    //
+    struct FFTPlan
+    {
+        int          m = 0;      // Power-of-two length of the transforms.
+        Vector<cplx> twiddle;    // exp(-2 pi i j/m), j < m/2.
+        Vector<cplx> chirp;      // exp(-pi i j^2/n), j < n (Bluestein only).
+        Vector<cplx> chirp_hat;  // Transform of the conjugate chirp, extended.
+    };
+
+    std::map<int,FFTPlan> fft_plans;
+
+    void fft_pow2 (cplx* a, int m, const Vector<cplx>& twiddle)
+    {
+        for (int i = 1, j = 0; i < m; ++i) {
+            int bit = m >> 1;
+            for ( ; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(a[i], a[j]);
+        }
+        for (int len = 2; len <= m; len <<= 1) {
+            const int stride = m/len;
+            for (int i = 0; i < m; i += len) {
+                for (int j = 0; j < len/2; ++j) {
+                    const cplx u = a[i+j];
+                    const cplx v = a[i+j+len/2]*twiddle[j*stride];
+                    a[i+j]       = u + v;
+                    a[i+j+len/2] = u - v;
+                }
+            }
+        }
+    }
+
+    const FFTPlan& fft_plan (int n)
+    {
+        auto it = fft_plans.find(n);
+        if (it != fft_plans.end()) return it->second;
+
+        FFTPlan& p = fft_plans[n];
+        const bool pow2 = (n & (n-1)) == 0;
+        p.m = 1;
+        while (p.m < (pow2 ? n : 2*n-1)) p.m <<= 1;
+
+        p.twiddle.resize(p.m/2);
+        for (int j = 0; j < p.m/2; ++j) {
+            const Real ang = -2.0*M_PI*j/p.m;
+            p.twiddle[j] = cplx(std::cos(ang), std::sin(ang));
+        }
+
+        if (!pow2)
+        {
+            p.chirp.resize(n);
+            p.chirp_hat.assign(p.m, cplx(0.0));
+            for (int j = 0; j < n; ++j) {
+                // j^2 mod 2n keeps the angle small and exact.
+                const Real ang = -M_PI*Real((long long)j*j % (2LL*n))/n;
+                p.chirp[j] = cplx(std::cos(ang), std::sin(ang));
+                p.chirp_hat[j] = std::conj(p.chirp[j]);
+                if (j > 0) p.chirp_hat[p.m-j] = std::conj(p.chirp[j]);
+            }
+            fft_pow2(p.chirp_hat.data(), p.m, p.twiddle);
+        }
+        return p;
+    }
+
+    //
+    // In-place forward transform of n values.
+    //
+    void fft1d (cplx* a, int n, Vector<cplx>& work)
+    {
+        if (n <= 1) return;
+
+        const FFTPlan& p = fft_plan(n);
+        if (p.chirp.empty())
+        {
+            fft_pow2(a, n, p.twiddle);
+            return;
+        }
+
+        //
+        // Bluestein: X_k = c_k sum_j (a_j c_j) conj(c_{k-j}), with the
+        // convolution done by transforms of length m.
+        //
+        work.assign(p.m, cplx(0.0));
+        for (int j = 0; j < n; ++j) {
+            work[j] = a[j]*p.chirp[j];
+        }
+        fft_pow2(work.data(), p.m, p.twiddle);
+        for (int j = 0; j < p.m; ++j) {
+            work[j] = std::conj(work[j]*p.chirp_hat[j]);
+        }
+        fft_pow2(work.data(), p.m, p.twiddle);   // inverse, through conjugation
+        const Real scale = 1.0/p.m;
+        for (int k = 0; k < n; ++k) {
+            a[k] = p.chirp[k]*std::conj(work[k])*scale;
+        }
+    }
+
+    //
+    // Transforms along direction dir every line of a box held in a
+    // two-component (real, imaginary) host fab.
+    //
+    void fft_lines (FArrayBox& fab, const Box& bx, int dir)
+    {
+        const int n = bx.length(dir);
+        Array4<Real> const& f = fab.array();
+
+        Box lines = bx;
+        lines.setBig(dir, bx.smallEnd(dir));
+
+        Vector<cplx> line(n), work;
+        for (BoxIterator bit(lines); bit.ok(); ++bit)
+        {
+            IntVect iv = bit();
+            for (int m = 0; m < n; ++m) {
+                iv[dir] = bx.smallEnd(dir) + m;
+                line[m] = cplx(f(iv,0), f(iv,1));
+            }
+            fft1d(line.data(), n, work);
+            for (int m = 0; m < n; ++m) {
+                iv[dir] = bx.smallEnd(dir) + m;
+                f(iv,0) = line[m].real();
+                f(iv,1) = line[m].imag();
+            }
+        }
+    }
+
+    //
+    // Box array chopping the domain along dir into at most nprocs pieces,
+    // one per rank.
+    //
+    BoxArray decompose (const Box& domain, int dir, int nprocs)
+    {
+        const int n = domain.length(dir);
+        const int np = std::min(nprocs, n);
+        BoxList bl;
+        for (int p = 0; p < np; ++p) {
+            Box b = domain;
+            b.setSmall(dir, domain.smallEnd(dir) + (p*n)/np);
+            b.setBig  (dir, domain.smallEnd(dir) + ((p+1)*n)/np - 1);
+            bl.push_back(b);
+        }
+        return BoxArray(bl);
+    }
+}
+
+void
+NavierStokesBase::read_spectrum_params ()
+{
+    ParmParse pp("spectrum");
+
+    pp.query("int", spectrum_int);
+    pp.queryarr("scalars", spectrum_scalars);
+    pp.query("file", spectrum_file);
+
+    if (spectrum_int > 0 && !DefaultGeometry().isAllPeriodic()) {
+        amrex::Abort("NavierStokesBase::read_spectrum_params(): spectrum.int requires a fully periodic domain");
+    }
+}
+
+bool
+NavierStokesBase::spectrum_due (int step)
+{
+    return spectrum_int > 0 && step % spectrum_int == 0;
+}
+
+void
+NavierStokesBase::compute_spectrum ()
+{
+    BL_PROFILE("NavierStokesBase::compute_spectrum()");
+
+    AMREX_ASSERT(level == 0);
+
+    const Real strt_time = ParallelDescriptor::second();
+
+    const Real time   = state[State_Type].curTime();
+    const Box& domain = geom.Domain();
+    const int  nprocs = ParallelDescriptor::NProcs();
+    const int  last   = AMREX_SPACEDIM-1;
+
+    //
+    // Slabs normal to the last direction and pencils along it.
+    //
+    const BoxArray slab_ba = decompose(domain, last, nprocs);
+    const BoxArray pncl_ba = decompose(domain, 0, nprocs);
+    Vector<int> slab_pmap(slab_ba.size()), pncl_pmap(pncl_ba.size());
+    for (int i = 0; i < slab_ba.size(); ++i) slab_pmap[i] = i;
+    for (int i = 0; i < pncl_ba.size(); ++i) pncl_pmap[i] = i;
+    const DistributionMapping slab_dm(std::move(slab_pmap));
+    const DistributionMapping pncl_dm(std::move(pncl_pmap));
+
+    MultiFab slab(slab_ba, slab_dm, 2, 0, MFInfo().SetArena(The_Pinned_Arena()));
+    MultiFab pncl(pncl_ba, pncl_dm, 2, 0, MFInfo().SetArena(The_Pinned_Arena()));
+
+    //
+    // Shells up to the corner of the wavenumber box, in units of
+    // 2 pi / L_x, so that every mode is counted.
+    //
+    Real kcorner2 = 0.0;
+    for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+        const Real kd = Real(domain.length(d)/2) * geom.ProbLength(0)/geom.ProbLength(d);
+        kcorner2 += kd*kd;
+    }
+    const int nshell = int(std::sqrt(kcorner2) + 0.5) + 1;
+
+    const Vector<std::string> vel_names{AMREX_D_DECL("x_velocity","y_velocity","z_velocity")};
+    Vector<Vector<std::string>> fields;
+    fields.push_back(vel_names);
+    for (const auto& s : spectrum_scalars) fields.push_back({s});
+
+    const Real npts  = domain.d_numPts();
+    const Real norm  = 0.5/(npts*npts);
+
+    Vector<Real> spectra(fields.size()*nshell, 0.0);
+
+    for (int f = 0; f < fields.size(); ++f)
+    {
+        for (const auto& name : fields[f])
+        {
+            int type, comp;
+            std::unique_ptr<MultiFab> derived;
+            const MultiFab* src;
+            if (isStateVariable(name, type, comp) && type == State_Type) {
+                src = &get_new_data(State_Type);
+            } else {
+                derived = derive(name, time, 0);
+                src  = derived.get();
+                comp = 0;
+            }
+
+            slab.setVal(0.0);
+            slab.ParallelCopy(*src, comp, 0, 1);
+
+            for (MFIter mfi(slab); mfi.isValid(); ++mfi) {
+                for (int d = 0; d < last; ++d) {
+                    fft_lines(slab[mfi], mfi.validbox(), d);
+                }
+            }
+
+            pncl.ParallelCopy(slab, 0, 0, 2);
+
+            for (MFIter mfi(pncl); mfi.isValid(); ++mfi)
+            {
+                const Box& bx = mfi.validbox();
+                fft_lines(pncl[mfi], bx, last);
+
+                Array4<Real const> const& a = pncl.const_array(mfi);
+                for (BoxIterator bit(bx); bit.ok(); ++bit)
+                {
+                    const IntVect iv = bit();
+                    Real k2 = 0.0;
+                    for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                        const int n  = domain.length(d);
+                        const int m  = iv[d] - domain.smallEnd(d);
+                        const Real kd = Real(m <= n/2 ? m : m - n) * geom.ProbLength(0)/geom.ProbLength(d);
+                        k2 += kd*kd;
+                    }
+                    const int shell = std::min(int(std::sqrt(k2) + 0.5), nshell-1);
+                    spectra[f*nshell+shell] += norm*(a(iv,0)*a(iv,0) + a(iv,1)*a(iv,1));
+                }
+            }
+        }
+    }
+
+    ParallelDescriptor::ReduceRealSum(spectra.dataPtr(), spectra.size(),
+                                      ParallelDescriptor::IOProcessorNumber());
+
+    if (ParallelDescriptor::IOProcessor())
+    {
+        const bool new_file = !amrex::FileExists(spectrum_file);
+        std::ofstream ofs(spectrum_file, std::ios::out|std::ios::app);
+        if (!ofs.good()) {
+            amrex::FileOpenFailed(spectrum_file);
+        }
+        if (new_file)
+        {
+            ofs << "# step time, then E(k) for k = 0.." << nshell-1 << " for: kinetic_energy";
+            for (const auto& s : spectrum_scalars) ofs << ' ' << s;
+            ofs << '\n';
+        }
+        ofs.precision(9);
+        ofs << parent->levelSteps(0) << ' ' << time;
+        for (const auto& e : spectra) ofs << ' ' << e;
+        ofs << '\n';
+    }
+
+    if (verbose)
+    {
+        const int IOProc = ParallelDescriptor::IOProcessorNumber();
+        Real run_time = ParallelDescriptor::second() - strt_time;
+        ParallelDescriptor::ReduceRealMax(run_time,IOProc);
+        amrex::Print() << "NavierStokesBase::compute_spectrum(): lev: " << level
+                       << ", time: " << run_time << '\n';
+    }
+}
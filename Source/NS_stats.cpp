@@ -0,0 +1,497 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_PlotFileUtil.H>
+#include <AMReX_Utility.H>
+
+#include <fstream>
+#include <sstream>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Streaming statistics
+//
+//  Generalizes the velocity time averaging of NS_average.cpp to any set of
+//  state or derived variables:
+//
+//    stats.int               = 1          # sample every coarse step
+//    stats.vars              = x_velocity tracer
+//    stats.reynolds_stresses = 1          # adds the velocity and all u_i u_j
+//    stats.correlations      = x_velocity tracer   # extra pairs, flattened
+//    stats.higher_moments    = 1          # also third and fourth moments
+//    stats.weighting         = time       # or uniform
+//    stats.plot_int          = 100        # write a stats plotfile
+//    stats.plot_file         = stats_plt
+//
+//  Each level keeps a single MultiFab of accumulators, updated in place by
+//  one kernel per box and sample with the weighted Welford / Pebay update:
+//  per variable the mean and the central sums M2 (and M3, M4), and per pair
+//  the co-moment C. All the levels are sampled together after the level 0
+//  post_timestep, so they share one total weight.
+//
+//  Only the accumulators are checkpointed, one MultiFab per level in
+//  Level_<lev>/Stats plus a small StatsHeader; the stats plotfile holds the
+//  normalized quantities: mean_, var_, (skew_, kurt_,) cov_<a>_<b>.
+//---------------------------------------------------------------------
+
+namespace
+{
+    constexpr int max_stats_vars = 16;
+
+    Vector<std::string> stats_vars;      // One entry per single component.
+    Vector<std::string> stats_derive;    // Variables as derived, before splitting.
+    Vector<int>         stats_derive_ncomp;
+    Vector<std::string> stats_corr_names; // Pairs by name, resolved in stats_setup.
+    Vector<std::pair<int,int>> stats_pairs;
+    int                 stats_int        = -1;
+    int                 stats_nmom       = 2;
+    bool                stats_uniform    = false;
+    int                 stats_plot_int   = -1;
+    std::string         stats_plot_file("stats_plt");
+
+    Real                stats_weight     = 0.0;
+    Real                stats_last_time  = -1.0;
+
+    int stats_ncomp ()
+    {
+        return stats_vars.size()*stats_nmom + stats_pairs.size();
+    }
+
+    int stats_var_index (const std::string& name)
+    {
+        for (int v = 0; v < stats_vars.size(); ++v) {
+            if (stats_vars[v] == name) return v;
+        }
+        return -1;
+    }
+
+    //
+    // Describes the configuration, to check it on restart.
+    //
+    std::string stats_signature ()
+    {
+        std::ostringstream os;
+        os << stats_nmom << ' ' << stats_vars.size();
+        for (const auto& v : stats_vars) os << ' ' << v;
+        os << ' ' << stats_pairs.size();
+        for (const auto& p : stats_pairs) os << ' ' << p.first << ' ' << p.second;
+        return os.str();
+    }
+}
+
+void
+NavierStokesBase::read_stats_params ()
+{
+    ParmParse pp("stats");
+
+    pp.query("int", stats_int);
+    pp.query("plot_int", stats_plot_int);
+    pp.query("plot_file", stats_plot_file);
+
+    int higher_moments = 0;
+    pp.query("higher_moments", higher_moments);
+    stats_nmom = higher_moments ? 4 : 2;
+
+    std::string weighting("time");
+    pp.query("weighting", weighting);
+    if (weighting != "time" && weighting != "uniform") {
+        amrex::Abort("NavierStokesBase::read_stats_params(): stats.weighting must be time or uniform");
+    }
+    stats_uniform = (weighting == "uniform");
+
+    Vector<std::string> names;
+    pp.queryarr("vars", names);
+
+    int reynolds_stresses = 0;
+    pp.query("reynolds_stresses", reynolds_stresses);
+    const Vector<std::string> vel_names{AMREX_D_DECL("x_velocity","y_velocity","z_velocity")};
+    if (reynolds_stresses) {
+        for (const auto& v : vel_names) {
+            if (std::find(names.begin(), names.end(), v) == names.end()) {
+                names.push_back(v);
+            }
+        }
+    }
+
+    if (stats_int <= 0 || names.empty()) {
+        stats_int = -1;
+        return;
+    }
+
+    stats_derive = names;
+
+    Vector<std::string> corr;
+    pp.queryarr("correlations", corr);
+    if (corr.size() % 2 != 0) {
+        amrex::Abort("NavierStokesBase::read_stats_params(): stats.correlations must hold pairs of variables");
+    }
+
+    // The variables are split into single components once the
+    // derive list is known; keep the pairs by name until then.
+    if (reynolds_stresses) {
+        for (int a = 0; a < AMREX_SPACEDIM; ++a) {
+            for (int b = a; b < AMREX_SPACEDIM; ++b) {
+                corr.push_back(vel_names[a]);
+                corr.push_back(vel_names[b]);
+            }
+        }
+    }
+    stats_corr_names = corr;
+}
+
+//
+// Splits the variables into components; needs the derive list, so this is
+// done on first use.
+//
+void
+NavierStokesBase::stats_setup ()
+{
+    if (!stats_vars.empty()) return;
+
+    for (const auto& name : stats_derive)
+    {
+        const int nc = derive_num_comp(name);
+        stats_derive_ncomp.push_back(nc);
+        if (nc == 1) {
+            stats_vars.push_back(name);
+        } else {
+            for (int n = 0; n < nc; ++n) {
+                stats_vars.push_back(name + "_" + std::to_string(n));
+            }
+        }
+    }
+
+    if (stats_vars.size() > max_stats_vars) {
+        amrex::Abort("NavierStokesBase::stats_setup(): too many statistics variables, the maximum is "
+                     + std::to_string(max_stats_vars));
+    }
+
+    const auto& corr = stats_corr_names;
+    for (int i = 0; i < corr.size(); i += 2)
+    {
+        const int a = stats_var_index(corr[i]);
+        const int b = stats_var_index(corr[i+1]);
+        if (a < 0 || b < 0) {
+            amrex::Abort("NavierStokesBase::stats_setup(): correlation of " + corr[i] + " and "
+                         + corr[i+1] + " needs both in stats.vars");
+        }
+        stats_pairs.emplace_back(a, b);
+    }
+}
+
+bool
+NavierStokesBase::stats_sample_due (int step)
+{
+    return stats_int > 0 && step % stats_int == 0;
+}
+
+//
+// (Re)build the accumulators on the current grids, from the previous
+// version of this level where it existed and from the coarser level
+// elsewhere (piecewise constant).
+//
+void
+NavierStokesBase::stats_regrid (const NavierStokesBase* old)
+{
+    if (stats_int <= 0) return;
+
+    stats_setup();
+    const int ncomp = stats_ncomp();
+
+    stats_acc = std::make_unique<MultiFab>(grids, dmap, ncomp, 0);
+    stats_acc->setVal(0.0);
+
+    if (level > 0 && getLevel(level-1).stats_acc)
+    {
+        const MultiFab& crse = *getLevel(level-1).stats_acc;
+        const IntVect ratio = parent->refRatio(level-1);
+
+        BoxArray cba = grids;
+        cba.coarsen(ratio);
+        MultiFab crse_patch(cba, dmap, ncomp, 0);
+        crse_patch.ParallelCopy(crse, 0, 0, ncomp);
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+        for (MFIter mfi(*stats_acc,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+        {
+            const Box& bx = mfi.tilebox();
+            auto const& f = stats_acc->array(mfi);
+            auto const& c = crse_patch.const_array(mfi);
+            amrex::ParallelFor(bx, ncomp, [f,c,ratio]
+            AMREX_GPU_DEVICE (int i, int j, int k, int n) noexcept
+            {
+                IntVect iv(AMREX_D_DECL(i,j,k));
+                f(iv,n) = c(amrex::coarsen(iv,ratio),n);
+            });
+        }
+    }
+
+    if (old && old->stats_acc) {
+        stats_acc->ParallelCopy(*old->stats_acc, 0, 0, ncomp);
+    }
+}
+
+//
+// Called on level 0 once all levels have finished the coarse step:
+// one fused update of all the accumulators per box.
+//
+void
+NavierStokesBase::stats_sample ()
+{
+    BL_PROFILE("NavierStokesBase::stats_sample()");
+
+    AMREX_ASSERT(level == 0);
+
+    stats_setup();
+
+    const int  finest_level = parent->finestLevel();
+    const Real time         = state[State_Type].curTime();
+
+    Real w = 1.0;
+    if (!stats_uniform) {
+        w = (stats_last_time < 0.0) ? parent->dtLevel(0) : time - stats_last_time;
+    }
+    stats_last_time = time;
+    if (w <= 0.0) return;
+
+    const Real na = stats_weight;
+    const Real nb = w;
+    const Real n  = na + nb;
+
+    const int nvars  = stats_vars.size();
+    const int nmom   = stats_nmom;
+    const int npairs = stats_pairs.size();
+
+    Vector<int> h_pairs;
+    for (const auto& p : stats_pairs) {
+        h_pairs.push_back(p.first);
+        h_pairs.push_back(p.second);
+    }
+    AsyncArray<int> pairs_lcl(h_pairs.data(), std::max(1, 2*npairs));
+    const int* pairs = pairs_lcl.data();
+
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        NavierStokesBase& ns_level = getLevel(lev);
+
+        if (!ns_level.stats_acc) {
+            ns_level.stats_regrid(nullptr);
+        }
+        MultiFab& acc = *ns_level.stats_acc;
+
+        //
+        // Inputs: State_Type components are used in place, the other
+        // variables are derived on the level.
+        //
+        MultiFab& S_new = ns_level.get_new_data(State_Type);
+        Vector<std::unique_ptr<MultiFab>> derived;
+        Vector<const MultiFab*> src_mf;
+        Vector<int>             src_comp;
+        for (int d = 0; d < stats_derive.size(); ++d)
+        {
+            int type, comp;
+            if (ns_level.isStateVariable(stats_derive[d], type, comp) && type == State_Type)
+            {
+                src_mf.push_back(&S_new);
+                src_comp.push_back(comp);
+            }
+            else
+            {
+                derived.push_back(ns_level.derive(stats_derive[d], time, 0));
+                for (int c = 0; c < stats_derive_ncomp[d]; ++c) {
+                    src_mf.push_back(derived.back().get());
+                    src_comp.push_back(c);
+                }
+            }
+        }
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+        for (MFIter mfi(acc,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+        {
+            const Box& bx = mfi.tilebox();
+            auto const& a = acc.array(mfi);
+
+            GpuArray<Array4<Real const>,max_stats_vars> in;
+            GpuArray<int,max_stats_vars> in_comp;
+            for (int v = 0; v < nvars; ++v) {
+                in[v]      = src_mf[v]->const_array(mfi);
+                in_comp[v] = src_comp[v];
+            }
+
+            amrex::ParallelFor(bx, [a,in,in_comp,pairs,nvars,nmom,npairs,na,nb,n]
+            AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+            {
+                Real delta[max_stats_vars];
+                for (int v = 0; v < nvars; ++v)
+                {
+                    const int  m  = v*nmom;
+                    const Real x  = in[v](i,j,k,in_comp[v]);
+                    const Real d  = x - a(i,j,k,m);
+                    const Real M2 = a(i,j,k,m+1);
+                    delta[v] = d;
+                    if (nmom == 4) {
+                        const Real M3 = a(i,j,k,m+2);
+                        a(i,j,k,m+3) += d*d*d*d*na*nb*(na*na - na*nb + nb*nb)/(n*n*n)
+                            + 6.0*d*d*nb*nb*M2/(n*n) - 4.0*d*nb*M3/n;
+                        a(i,j,k,m+2) += d*d*d*na*nb*(na - nb)/(n*n) - 3.0*d*nb*M2/n;
+                    }
+                    a(i,j,k,m+1) += d*d*na*nb/n;
+                    a(i,j,k,m)   += d*nb/n;
+                }
+                for (int p = 0; p < npairs; ++p) {
+                    a(i,j,k,nvars*nmom+p) += delta[pairs[2*p]]*delta[pairs[2*p+1]]*na*nb/n;
+                }
+            });
+        }
+    }
+
+    stats_weight = n;
+
+    if (stats_plot_int > 0 && parent->levelSteps(0) % stats_plot_int == 0) {
+        stats_write_plotfile();
+    }
+}
+
+//
+// Multi-level plotfile of the normalized statistics.
+//
+void
+NavierStokesBase::stats_write_plotfile ()
+{
+    BL_PROFILE("NavierStokesBase::stats_write_plotfile()");
+
+    if (stats_weight <= 0.0) return;
+
+    const int finest_level = parent->finestLevel();
+    const int nvars  = stats_vars.size();
+    const int nmom   = stats_nmom;
+    const int npairs = stats_pairs.size();
+    const int ncomp  = stats_ncomp();
+    const Real W     = stats_weight;
+
+    Vector<std::string> names;
+    for (const auto& v : stats_vars) names.push_back("mean_" + v);
+    for (const auto& v : stats_vars) names.push_back("var_" + v);
+    if (nmom == 4) {
+        for (const auto& v : stats_vars) names.push_back("skew_" + v);
+        for (const auto& v : stats_vars) names.push_back("kurt_" + v);
+    }
+    for (const auto& p : stats_pairs) {
+        names.push_back("cov_" + stats_vars[p.first] + "_" + stats_vars[p.second]);
+    }
+
+    Vector<MultiFab> out(finest_level+1);
+    Vector<Geometry> geoms(finest_level+1);
+    Vector<int>      steps(finest_level+1);
+    Vector<IntVect>  ratios(finest_level);
+    for (int lev = 0; lev <= finest_level; ++lev)
+    {
+        const MultiFab& acc = *getLevel(lev).stats_acc;
+        out[lev].define(acc.boxArray(), acc.DistributionMap(), ncomp, 0);
+        geoms[lev] = parent->Geom(lev);
+        steps[lev] = parent->levelSteps(lev);
+        if (lev < finest_level) ratios[lev] = parent->refRatio(lev);
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+        for (MFIter mfi(out[lev],TilingIfNotGPU()); mfi.isValid(); ++mfi)
+        {
+            const Box& bx = mfi.tilebox();
+            auto const& a = acc.const_array(mfi);
+            auto const& o = out[lev].array(mfi);
+            amrex::ParallelFor(bx, [a,o,nvars,nmom,npairs,W]
+            AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+            {
+                for (int v = 0; v < nvars; ++v)
+                {
+                    const int  m   = v*nmom;
+                    const Real var = a(i,j,k,m+1)/W;
+                    o(i,j,k,v)       = a(i,j,k,m);
+                    o(i,j,k,nvars+v) = var;
+                    if (nmom == 4) {
+                        const bool ok = var > 1.e-300;
+                        o(i,j,k,2*nvars+v) = ok ? a(i,j,k,m+2)/W/(var*std::sqrt(var)) : 0.0;
+                        o(i,j,k,3*nvars+v) = ok ? a(i,j,k,m+3)/W/(var*var) : 0.0;
+                    }
+                }
+                for (int p = 0; p < npairs; ++p) {
+                    o(i,j,k,(nmom == 4 ? 4 : 2)*nvars+p) = a(i,j,k,nvars*nmom+p)/W;
+                }
+            });
+        }
+    }
+
+    const std::string pltfile = amrex::Concatenate(stats_plot_file, parent->levelSteps(0), 5);
+    amrex::WriteMultiLevelPlotfile(pltfile, finest_level+1, amrex::GetVecOfConstPtrs(out),
+                                   names, geoms, state[State_Type].curTime(), steps, ratios);
+
+    if (verbose) {
+        amrex::Print() << "NavierStokesBase::stats_write_plotfile(): wrote " << pltfile
+                       << " (total weight " << W << ")\n";
+    }
+}
+
+void
+NavierStokesBase::stats_checkpoint (const std::string& dir)
+{
+    if (stats_int <= 0 || !stats_acc) return;
+
+    VisMF::Write(*stats_acc, dir + "/Level_" + std::to_string(level) + "/Stats");
+
+    if (level == 0 && ParallelDescriptor::IOProcessor())
+    {
+        std::ofstream ofs(dir + "/StatsHeader", std::ios::out|std::ios::trunc);
+        if (!ofs.good()) {
+            amrex::FileOpenFailed(dir + "/StatsHeader");
+        }
+        ofs.precision(17);
+        ofs << stats_signature() << '\n'
+            << stats_weight << '\n'
+            << stats_last_time << '\n';
+    }
+}
+
+void
+NavierStokesBase::stats_restart (const std::string& dir)
+{
+    if (stats_int <= 0) return;
+
+    stats_setup();
+
+    const std::string hdr = dir + "/StatsHeader";
+    if (!amrex::FileExists(hdr))
+    {
+        amrex::Print() << "NavierStokesBase::stats_restart(): no statistics in " << dir
+                       << ", starting from zero\n";
+        stats_regrid(nullptr);
+        return;
+    }
+
+    Vector<char> fileCharPtr;
+    ParallelDescriptor::ReadAndBcastFile(hdr, fileCharPtr);
+    std::istringstream is(std::string(fileCharPtr.dataPtr()));
+
+    std::string signature;
+    std::getline(is, signature);
+    Real weight, last_time;
+    is >> weight >> last_time;
+
+    if (signature != stats_signature())
+    {
+        amrex::Print() << "NavierStokesBase::stats_restart(): statistics configuration changed,"
+                       << " starting from zero\n";
+        stats_regrid(nullptr);
+        return;
+    }
+
+    stats_weight    = weight;
+    stats_last_time = last_time;
+
+    stats_acc = std::make_unique<MultiFab>(grids, dmap, stats_ncomp(), 0);
+    VisMF::Read(*stats_acc, dir + "/Level_" + std::to_string(level) + "/Stats");
+}
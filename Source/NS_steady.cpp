@@ -0,0 +1,173 @@
+#include <NavierStokesBase.H>
+#include <AMReX_ParmParse.H>
+
+#include <limits>
+
+using namespace amrex;
+
+//--------------------------------------------------------------------
+// Local pseudo-time stepping towards a steady state
+//
+//    ns.steady_local_dt     = 1
+//    ns.steady_max_dt_ratio = 10
+//    ns.stop_when_steady    = 1
+//    ns.steady_tol          = 1.e-8
+//
+//  With steady_local_dt, the velocity update is relaxed cell by cell
+//  before the level projection:
+//
+//    u^n+1 = u^n + w (u* - u^n),   w = min(ratio, max(1, dtau/dt))
+//
+//  where u* is the regular update with the level dt, and dtau is the
+//  local time step allowed at the cell by the CFL number on this level's
+//  mesh and, for viscous flow, by the explicit viscous limit. The
+//  projection then restores the divergence constraint. The density and
+//  the scalars, conservative ones included, keep the regular update with
+//  the level dt, so that rho and rho*c stay consistent. The steady
+//  solution, for which u* = u^n, is unchanged, but cells whose local
+//  limit is larger than the level dt, e.g. in slow regions or on coarse
+//  levels without subcycling (amr.subcycling_mode = None), march faster.
+//  The transient is not time accurate.
+//
+//  The steady residual max |S* - S^n|/dt of the velocity is recorded on
+//  every level, and with stop_when_steady the run stops once it is below
+//  steady_tol on all levels. be_cn_theta = 1 is recommended, as the
+//  relaxed Crank-Nicolson increment is less robust for stiff modes.
+//---------------------------------------------------------------------
+
+namespace
+{
+    int  steady_local_dt     = 0;
+    Real steady_max_dt_ratio = 10.0;
+}
+
+void
+NavierStokesBase::read_steady_params ()
+{
+    ParmParse pp("ns");
+
+    pp.query("steady_local_dt",     steady_local_dt);
+    pp.query("steady_max_dt_ratio", steady_max_dt_ratio);
+
+    if (steady_local_dt && steady_max_dt_ratio < 1.0) {
+        amrex::Abort("NavierStokesBase::read_steady_params(): steady_max_dt_ratio must be >= 1");
+    }
+}
+
+bool
+NavierStokesBase::steady_local_dt_active ()
+{
+    return steady_local_dt != 0;
+}
+
+void
+NavierStokesBase::steady_local_update (Real dt)
+{
+    BL_PROFILE("NavierStokesBase::steady_local_update()");
+
+    MultiFab&       S_new = get_new_data(State_Type);
+    const MultiFab& S_old = get_old_data(State_Type);
+
+    const auto dx        = geom.CellSizeArray();
+    const Real cfl_l     = cfl;
+    const Real max_ratio = steady_max_dt_ratio;
+    const bool viscous   = is_diffusive[Xvel];
+    const int  dens      = Density;
+
+    Real dxmin2 = dx[0]*dx[0];
+    for (int d = 1; d < AMREX_SPACEDIM; ++d) {
+        dxmin2 = std::min(dxmin2, dx[d]*dx[d]);
+    }
+
+    ReduceOps<ReduceOpMax> reduce_op;
+    ReduceData<Real> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+    for (MFIter mfi(S_new,TilingIfNotGPU()); mfi.isValid(); ++mfi)
+    {
+        const Box& bx = mfi.tilebox();
+
+        auto const& sn   = S_new.array(mfi);
+        auto const& so   = S_old.const_array(mfi);
+        auto const& visc = viscn_cc->const_array(mfi);
+#ifdef AMREX_USE_EB
+        auto const& vfrac = EBFactory().getVolFrac().const_array(mfi);
+#endif
+
+        reduce_op.eval(bx, reduce_data, [=]
+        AMREX_GPU_DEVICE (int i, int j, int k) noexcept -> ReduceTuple
+        {
+#ifdef AMREX_USE_EB
+            if (vfrac(i,j,k) == 0.0) return {0.0};
+#endif
+            //
+            // Local time step from the CFL and viscous limits.
+            //
+            Real dtau = std::numeric_limits<Real>::max();
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                const Real u = amrex::Math::abs(so(i,j,k,Xvel+d));
+                if (u > 1.0e-12) dtau = amrex::min(dtau, cfl_l*dx[d]/u);
+            }
+            if (viscous) {
+                const Real nu = visc(i,j,k)/so(i,j,k,dens);
+                if (nu > 0.0) dtau = amrex::min(dtau, dxmin2/(2.0*AMREX_SPACEDIM*nu));
+            }
+            const Real w = amrex::min(max_ratio, amrex::max(Real(1.0), dtau/dt));
+
+            Real res = 0.0;
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                res = amrex::max(res, amrex::Math::abs(sn(i,j,k,Xvel+d) - so(i,j,k,Xvel+d))/dt);
+            }
+
+            //
+            // Only the velocity is relaxed: the density and the scalars keep
+            // the level dt, so that conserved rho*c stays consistent with rho.
+            //
+            for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+                sn(i,j,k,Xvel+d) = so(i,j,k,Xvel+d) + w*(sn(i,j,k,Xvel+d) - so(i,j,k,Xvel+d));
+            }
+            return {res};
+        });
+    }
+
+    steady_res = amrex::get<0>(reduce_data.value(reduce_op));
+    ParallelDescriptor::ReduceRealMax(steady_res);
+
+    if (verbose)
+    {
+        amrex::Print() << "NavierStokesBase::steady_local_update(): lev: " << level
+                       << ", residual: " << steady_res << '\n';
+    }
+}
+
+bool
+NavierStokesBase::steady_residual_converged ()
+{
+    //
+    // Level 0 decides for all levels.
+    //
+    if (level > 0) return false;
+
+    Real res = 0.0;
+    for (int lev = 0; lev <= parent->finestLevel(); ++lev) {
+        res = std::max(res, getLevel(lev).steady_res);
+    }
+
+    const bool steady = res < steady_tol;
+
+    if (verbose)
+    {
+        amrex::Print() << "steadyState :: max residual over levels = " << res << std::endl;
+        if (steady)
+        {
+            amrex::Print()
+                << "System reached steady-state, stopping simulation."
+                << std::endl;
+        }
+    }
+
+    return steady;
+}
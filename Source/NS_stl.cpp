@@ -0,0 +1,473 @@
+#include <NS_stl.H>
+
+#if (AMREX_SPACEDIM == 3)
+
+#include <AMReX.H>
+#include <AMReX_Print.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Utility.H>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#ifdef AMREX_USE_OMP
+#include <omp.h>
+#endif
+
+using namespace amrex;
+
+namespace
+{
+    constexpr int leaf_size = 4;
+
+    //
+    // Subtrees larger than this are built as separate OpenMP tasks.
+    //
+    constexpr int task_size = 4096;
+
+    inline RealArray sub (const RealArray& a, const RealArray& b) noexcept
+    {
+        return {a[0]-b[0], a[1]-b[1], a[2]-b[2]};
+    }
+
+    inline Real dot (const RealArray& a, const RealArray& b) noexcept
+    {
+        return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+    }
+
+    inline RealArray cross (const RealArray& a, const RealArray& b) noexcept
+    {
+        return {a[1]*b[2]-a[2]*b[1], a[2]*b[0]-a[0]*b[2], a[0]*b[1]-a[1]*b[0]};
+    }
+
+    //
+    // Squared distance from p to the closest point of a triangle
+    // (Ericson, Real-Time Collision Detection, 5.1.5).
+    //
+    Real dist2_point_triangle (const RealArray& p, const STLIF::Triangle& t) noexcept
+    {
+        const RealArray ab = sub(t.v1, t.v0);
+        const RealArray ac = sub(t.v2, t.v0);
+        const RealArray ap = sub(p, t.v0);
+
+        RealArray c;
+        const Real d1 = dot(ab, ap);
+        const Real d2 = dot(ac, ap);
+        const RealArray bp = sub(p, t.v1);
+        const Real d3 = dot(ab, bp);
+        const Real d4 = dot(ac, bp);
+        const RealArray cp = sub(p, t.v2);
+        const Real d5 = dot(ab, cp);
+        const Real d6 = dot(ac, cp);
+        const Real vc = d1*d4 - d3*d2;
+        const Real vb = d5*d2 - d1*d6;
+        const Real va = d3*d6 - d5*d4;
+
+        if (d1 <= 0. && d2 <= 0.) {
+            c = t.v0;
+        } else if (d3 >= 0. && d4 <= d3) {
+            c = t.v1;
+        } else if (d6 >= 0. && d5 <= d6) {
+            c = t.v2;
+        } else if (vc <= 0. && d1 >= 0. && d3 <= 0.) {
+            const Real v = d1 / (d1 - d3);
+            c = {t.v0[0]+v*ab[0], t.v0[1]+v*ab[1], t.v0[2]+v*ab[2]};
+        } else if (vb <= 0. && d2 >= 0. && d6 <= 0.) {
+            const Real w = d2 / (d2 - d6);
+            c = {t.v0[0]+w*ac[0], t.v0[1]+w*ac[1], t.v0[2]+w*ac[2]};
+        } else if (va <= 0. && (d4-d3) >= 0. && (d5-d6) >= 0.) {
+            const Real w = (d4-d3) / ((d4-d3) + (d5-d6));
+            c = {t.v1[0]+w*(t.v2[0]-t.v1[0]),
+                 t.v1[1]+w*(t.v2[1]-t.v1[1]),
+                 t.v1[2]+w*(t.v2[2]-t.v1[2])};
+        } else {
+            const Real denom = 1. / (va + vb + vc);
+            const Real v = vb * denom;
+            const Real w = vc * denom;
+            c = {t.v0[0]+ab[0]*v+ac[0]*w,
+                 t.v0[1]+ab[1]*v+ac[1]*w,
+                 t.v0[2]+ab[2]*v+ac[2]*w};
+        }
+
+        const RealArray d = sub(p, c);
+        return dot(d, d);
+    }
+
+    //
+    // Squared distance from p to an axis-aligned box (0 inside).
+    //
+    inline Real dist2_point_box (const RealArray& p, const RealArray& lo,
+                                 const RealArray& hi) noexcept
+    {
+        Real r = 0.;
+        for (int d = 0; d < 3; ++d) {
+            const Real e = amrex::max(lo[d] - p[d], Real(0.), p[d] - hi[d]);
+            r += e*e;
+        }
+        return r;
+    }
+
+    //
+    // Does the ray p + t*dir, t > 0, hit the box?
+    //
+    inline bool ray_hits_box (const RealArray& p, const RealArray& inv_dir,
+                              const RealArray& lo, const RealArray& hi) noexcept
+    {
+        Real tmin = 0.;
+        Real tmax = std::numeric_limits<Real>::max();
+        for (int d = 0; d < 3; ++d) {
+            Real t0 = (lo[d] - p[d]) * inv_dir[d];
+            Real t1 = (hi[d] - p[d]) * inv_dir[d];
+            if (t0 > t1) std::swap(t0, t1);
+            tmin = amrex::max(tmin, t0);
+            tmax = amrex::min(tmax, t1);
+            if (tmax < tmin) return false;
+        }
+        return true;
+    }
+
+    //
+    // Moller-Trumbore ray/triangle intersection for t > 0.
+    //
+    inline bool ray_hits_triangle (const RealArray& p, const RealArray& dir,
+                                   const STLIF::Triangle& t) noexcept
+    {
+        const RealArray e1 = sub(t.v1, t.v0);
+        const RealArray e2 = sub(t.v2, t.v0);
+        const RealArray h  = cross(dir, e2);
+        const Real a = dot(e1, h);
+        if (std::abs(a) < std::numeric_limits<Real>::min()) return false;
+        const Real f = 1. / a;
+        const RealArray s = sub(p, t.v0);
+        const Real u = f * dot(s, h);
+        if (u < 0. || u > 1.) return false;
+        const RealArray q = cross(s, e1);
+        const Real v = f * dot(dir, q);
+        if (v < 0. || u + v > 1.) return false;
+        return f * dot(e2, q) > 0.;
+    }
+
+    RealArray centroid (const STLIF::Triangle& t) noexcept
+    {
+        return {(t.v0[0]+t.v1[0]+t.v2[0])/3.,
+                (t.v0[1]+t.v1[1]+t.v2[1])/3.,
+                (t.v0[2]+t.v1[2]+t.v2[2])/3.};
+    }
+
+    void read_stl_ascii (std::istream& is, Vector<Real>& coords)
+    {
+        std::string token;
+        while (is >> token) {
+            if (token == "vertex") {
+                Real x, y, z;
+                is >> x >> y >> z;
+                coords.push_back(x);
+                coords.push_back(y);
+                coords.push_back(z);
+            }
+        }
+    }
+
+    void read_stl_binary (std::istream& is, std::uint32_t ntri, Vector<Real>& coords)
+    {
+        coords.reserve(9*static_cast<Long>(ntri));
+        char rec[50];
+        for (std::uint32_t i = 0; i < ntri; ++i) {
+            is.read(rec, 50);
+            // Skip the 12 byte normal; the vertices follow as 9 float32.
+            for (int n = 0; n < 9; ++n) {
+                float v;
+                std::memcpy(&v, rec + 12 + 4*n, sizeof(float));
+                coords.push_back(static_cast<Real>(v));
+            }
+        }
+    }
+
+    //
+    // The IO processor reads the file and broadcasts the vertex coordinates.
+    //
+    Vector<Real> read_stl (const std::string& stl_file)
+    {
+        Vector<Real> coords;
+        Long ncoords = 0;
+
+        if (ParallelDescriptor::IOProcessor())
+        {
+            std::ifstream is(stl_file, std::ios::in | std::ios::binary);
+            if (!is.good()) {
+                amrex::FileOpenFailed(stl_file);
+            }
+
+            is.seekg(0, std::ios::end);
+            const Long file_size = is.tellg();
+            is.seekg(0, std::ios::beg);
+
+            //
+            // A binary STL is an 80 byte header, a 4 byte triangle count and
+            // 50 bytes per triangle. Anything else is read as ASCII.
+            //
+            bool is_binary = false;
+            std::uint32_t ntri = 0;
+            if (file_size >= 84) {
+                char header[80];
+                is.read(header, 80);
+                is.read(reinterpret_cast<char*>(&ntri), sizeof(ntri));
+                is_binary = (file_size == 84 + 50*static_cast<Long>(ntri));
+            }
+
+            if (is_binary) {
+                read_stl_binary(is, ntri, coords);
+            } else {
+                is.clear();
+                is.seekg(0, std::ios::beg);
+                read_stl_ascii(is, coords);
+            }
+
+            if (coords.empty() || coords.size() % 9 != 0) {
+                amrex::Abort("STLIF: could not read any triangle from " + stl_file);
+            }
+            ncoords = coords.size();
+        }
+
+        ParallelDescriptor::Bcast(&ncoords, 1, ParallelDescriptor::IOProcessorNumber());
+        coords.resize(ncoords);
+        ParallelDescriptor::Bcast(coords.data(), ncoords, ParallelDescriptor::IOProcessorNumber());
+
+        return coords;
+    }
+
+    struct BVHBuilder
+    {
+        const Vector<STLIF::Triangle>& tris;
+        Vector<RealArray> cents;
+        Vector<int> idx;
+        Vector<STLIF::Node>& nodes;
+        int nnodes = 0;
+
+        BVHBuilder (const Vector<STLIF::Triangle>& a_tris, Vector<STLIF::Node>& a_nodes)
+            : tris(a_tris), nodes(a_nodes)
+        {
+            const int ntri = tris.size();
+            cents.resize(ntri);
+            idx.resize(ntri);
+            for (int i = 0; i < ntri; ++i) {
+                cents[i] = centroid(tris[i]);
+                idx[i] = i;
+            }
+            // A binary tree with leaves of at least one triangle.
+            nodes.resize(2*ntri);
+        }
+
+        int new_node ()
+        {
+            int n;
+#ifdef AMREX_USE_OMP
+#pragma omp atomic capture
+#endif
+            n = nnodes++;
+            return n;
+        }
+
+        void build (int inode, int first, int count)
+        {
+            STLIF::Node& node = nodes[inode];
+
+            RealArray lo{ std::numeric_limits<Real>::max(),
+                          std::numeric_limits<Real>::max(),
+                          std::numeric_limits<Real>::max()};
+            RealArray hi{-std::numeric_limits<Real>::max(),
+                         -std::numeric_limits<Real>::max(),
+                         -std::numeric_limits<Real>::max()};
+            RealArray clo = lo, chi = hi;
+            for (int i = first; i < first+count; ++i) {
+                const STLIF::Triangle& t = tris[idx[i]];
+                for (int d = 0; d < 3; ++d) {
+                    lo[d] = amrex::min(lo[d], t.v0[d], t.v1[d], t.v2[d]);
+                    hi[d] = amrex::max(hi[d], t.v0[d], t.v1[d], t.v2[d]);
+                    clo[d] = amrex::min(clo[d], cents[idx[i]][d]);
+                    chi[d] = amrex::max(chi[d], cents[idx[i]][d]);
+                }
+            }
+            node.lo = lo;
+            node.hi = hi;
+
+            if (count <= leaf_size) {
+                node.first = first;
+                node.count = count;
+                return;
+            }
+
+            // Median split along the longest extent of the centroids.
+            int dir = 0;
+            for (int d = 1; d < 3; ++d) {
+                if (chi[d]-clo[d] > chi[dir]-clo[dir]) dir = d;
+            }
+            const int half = count/2;
+            std::nth_element(idx.begin()+first, idx.begin()+first+half, idx.begin()+first+count,
+                             [this,dir] (int a, int b) { return cents[a][dir] < cents[b][dir]; });
+
+            node.left  = new_node();
+            node.right = new_node();
+            const int left  = node.left;
+            const int right = node.right;
+
+            if (count > task_size) {
+#ifdef AMREX_USE_OMP
+#pragma omp task
+#endif
+                build(left, first, half);
+#ifdef AMREX_USE_OMP
+#pragma omp task
+#endif
+                build(right, first+half, count-half);
+#ifdef AMREX_USE_OMP
+#pragma omp taskwait
+#endif
+            } else {
+                build(left, first, half);
+                build(right, first+half, count-half);
+            }
+        }
+    };
+}
+
+STLIF::STLIF (const std::string& stl_file,
+              Real scale,
+              const RealArray& center,
+              bool reverse_normal,
+              Real max_distance)
+    : m_sign(reverse_normal ? -1. : 1.),
+      m_max_distance(max_distance)
+{
+    BL_PROFILE("STLIF::STLIF()");
+
+    const Real strt_time = ParallelDescriptor::second();
+
+    const Vector<Real> coords = read_stl(stl_file);
+    const int ntri = coords.size()/9;
+
+    auto data = std::make_shared<Data>();
+    Vector<Triangle> tris(ntri);
+    for (int i = 0; i < ntri; ++i) {
+        const Real* c = coords.data() + 9*static_cast<Long>(i);
+        for (int d = 0; d < 3; ++d) {
+            tris[i].v0[d] = c[d]  *scale + center[d];
+            tris[i].v1[d] = c[3+d]*scale + center[d];
+            tris[i].v2[d] = c[6+d]*scale + center[d];
+        }
+    }
+
+    //
+    // Every rank builds its own copy of the tree; the build is threaded.
+    //
+    BVHBuilder builder(tris, data->nodes);
+    const int root = builder.new_node();
+#ifdef AMREX_USE_OMP
+#pragma omp parallel
+#pragma omp single
+#endif
+    builder.build(root, 0, ntri);
+
+    data->nodes.resize(builder.nnodes);
+    data->nodes.shrink_to_fit();
+
+    // Store the triangles in leaf order for locality.
+    data->tris.resize(ntri);
+    for (int i = 0; i < ntri; ++i) {
+        data->tris[i] = tris[builder.idx[i]];
+    }
+
+    m_data = data;
+
+    Real run_time = ParallelDescriptor::second() - strt_time;
+    ParallelDescriptor::ReduceRealMax(run_time, ParallelDescriptor::IOProcessorNumber());
+    amrex::Print() << "STLIF: read " << ntri << " triangles from " << stl_file
+                   << " and built the BVH (" << data->nodes.size() << " nodes) in "
+                   << run_time << " s\n";
+}
+
+int
+STLIF::numTriangles () const noexcept
+{
+    return m_data->tris.size();
+}
+
+Real
+STLIF::distance (const RealArray& p) const noexcept
+{
+    const auto& nodes = m_data->nodes;
+    const auto& tris  = m_data->tris;
+
+    // Nothing further than the clipping distance needs to be visited.
+    Real best2 = m_max_distance*m_max_distance;
+
+    int stack[64];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const Node& node = nodes[stack[--sp]];
+        if (dist2_point_box(p, node.lo, node.hi) >= best2) continue;
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first+node.count; ++i) {
+                best2 = amrex::min(best2, dist2_point_triangle(p, tris[i]));
+            }
+        } else {
+            // Visit the closer child first.
+            const Real dl = dist2_point_box(p, nodes[node.left].lo, nodes[node.left].hi);
+            const Real dr = dist2_point_box(p, nodes[node.right].lo, nodes[node.right].hi);
+            if (dl < dr) {
+                stack[sp++] = node.right;
+                stack[sp++] = node.left;
+            } else {
+                stack[sp++] = node.left;
+                stack[sp++] = node.right;
+            }
+        }
+    }
+    return std::sqrt(best2);
+}
+
+bool
+STLIF::inside (const RealArray& p) const noexcept
+{
+    const auto& nodes = m_data->nodes;
+    const auto& tris  = m_data->tris;
+
+    //
+    // Ray parity test. The direction is deliberately not aligned with the
+    // grid so that rays through mesh edges and vertices are unlikely.
+    //
+    const RealArray dir{0.8506508083520399, 0.3090169943749474, 0.4253254041760200};
+    const RealArray inv_dir{1./dir[0], 1./dir[1], 1./dir[2]};
+
+    int nhits = 0;
+    int stack[64];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const Node& node = nodes[stack[--sp]];
+        if (!ray_hits_box(p, inv_dir, node.lo, node.hi)) continue;
+        if (node.left < 0) {
+            for (int i = node.first; i < node.first+node.count; ++i) {
+                if (ray_hits_triangle(p, dir, tris[i])) ++nhits;
+            }
+        } else {
+            stack[sp++] = node.left;
+            stack[sp++] = node.right;
+        }
+    }
+    return (nhits % 2) == 1;
+}
+
+Real
+STLIF::operator() (const RealArray& p) const noexcept
+{
+    const Real d = distance(p);
+    return inside(p) ? m_sign*d : -m_sign*d;
+}
+#endif
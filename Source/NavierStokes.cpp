@@ -334,6 +334,9 @@ NavierStokes::NavierStokes (Amr&            papa,
 void
 NavierStokes::initData ()
 {
+    if (level == 0) {
+        regrid_reset();
+    }
     //
     // Initialize the state and the pressure.
     //
@@ -601,15 +604,20 @@ NavierStokes::advance (Real time,
         create_umac_grown(umac_n_grow, nullptr);
     }
     //
-    // Advect velocities.
+    // Advect velocities. The viscous terms of the scalars do not depend on
+    // it, so they are computed first and their ghost cells are exchanged
+    // while it runs.
     //
+    const int first_scalar = Density;
+    const int last_scalar  = first_scalar + NUM_SCALARS - 1;
     if (do_mom_diff == 0)
+    {
+        start_scalar_visc_terms(first_scalar,last_scalar);
         velocity_advection(dt);
+    }
     //
     // Advect scalars.
     //
-    const int first_scalar = Density;
-    const int last_scalar  = first_scalar + NUM_SCALARS - 1;
     scalar_advection(dt,first_scalar,last_scalar);
     //
     // Update Rho.
@@ -643,6 +651,11 @@ NavierStokes::advance (Real time,
     // Add the advective and other terms to get velocity at t^{n+1}.
     //
     velocity_update(dt);
+    //
+    // Relax the update with local pseudo-time steps before the projection.
+    //
+    if (steady_local_dt_active() && !initial_step && !initial_iter)
+        steady_local_update(dt);
 
     //
     // Increment rho average.
@@ -690,6 +703,34 @@ NavierStokes::advance (Real time,
     return dt_test;  // Return estimate of best new timestep.
 }
 
+//
+// Compute the viscous terms of the scalars at t^n that scalar_advection
+// uses with Godunov, and post the exchange of their ghost cells; the
+// exchange is completed in scalar_advection.
+//
+void
+NavierStokes::start_scalar_visc_terms (int fscalar,
+                                       int lscalar)
+{
+    const bool is_godunov = advection_scheme == "Godunov_PLM" || advection_scheme == "Godunov_PPM" || advection_scheme == "BDS";
+    if (!is_godunov) return;
+
+    BL_PROFILE("NavierStokes::start_scalar_visc_terms()");
+
+    const int  num_scalars = lscalar - fscalar + 1;
+    const Real prev_time   = state[State_Type].prevTime();
+
+    scalar_visc_terms = std::make_unique<MultiFab>(grids,dmap,num_scalars,nghost_force(),MFInfo(),Factory());
+    scalar_visc_diffusive = false;
+
+    if (be_cn_theta != 1.0) {
+        scalar_visc_diffusive = post_visc_terms(*scalar_visc_terms,fscalar,num_scalars,prev_time,
+                                                scalar_visc_exchanges);
+    } else {
+        scalar_visc_terms->setVal(0.0,1);
+    }
+}
+
 //
 // This routine advects the scalars
 //
@@ -708,36 +749,43 @@ NavierStokes::scalar_advection (Real dt,
     const int   num_scalars    = lscalar - fscalar + 1;
     const Real  prev_time      = state[State_Type].prevTime();
 
-    // divu
-    std::unique_ptr<MultiFab> divu_fp(getDivCond(nghost_force(),prev_time));
+    const bool is_godunov = advection_scheme == "Godunov_PLM" || advection_scheme == "Godunov_PPM" || advection_scheme == "BDS";
+
+    // divu; Godunov uses divu at time n+1/2, shared with velocity_advection
+    std::unique_ptr<MultiFab> divu_mol;
+    const MultiFab* divu_fp;
+    if (is_godunov) {
+        divu_fp = &get_divu_half_time(dt);
+    } else {
+        divu_mol.reset(getDivCond(nghost_force(),prev_time));
+        divu_fp = divu_mol.get();
+    }
 
     //
-    // Start FillPatchIterator block
+    // Scalars and velocity come from the old state filled in advance_setup.
     //
     MultiFab forcing_term( grids, dmap, num_scalars, nghost_force(),MFInfo(),Factory());
 
-    FillPatchIterator S_fpi(*this,forcing_term,nghost_state(),prev_time,State_Type,fscalar,num_scalars);
-    MultiFab& Smf=S_fpi.get_mf();
+    const MultiFab& S_fill = get_old_state_filled();
+
+    MultiFab Smf(grids,dmap,num_scalars,nghost_state(),MFInfo(),Factory());
+    MultiFab::Copy(Smf,S_fill,fscalar,0,num_scalars,nghost_state());
 
     // Floor small values of states to be extrapolated
     floor(Smf);
 
-    if ( advection_scheme == "Godunov_PLM" || advection_scheme == "Godunov_PPM" || advection_scheme == "BDS")
+    if (is_godunov)
     {
-        MultiFab visc_terms(grids,dmap,num_scalars,nghost_force(),MFInfo(),Factory());
-        FillPatchIterator U_fpi(*this,visc_terms,nghost_state(),prev_time,State_Type,Xvel,AMREX_SPACEDIM);
-        const MultiFab& Umf=U_fpi.get_mf();
+        const MultiFab Umf(S_fill, amrex::make_alias, Xvel, AMREX_SPACEDIM);
 
-        {
-            std::unique_ptr<MultiFab> dsdt(getDsdt(nghost_force(),prev_time));
-            MultiFab::Saxpy(*divu_fp, 0.5*dt, *dsdt, 0, 0, 1, nghost_force());
+        // Compute viscous term, unless started before the velocity advection
+        if (!scalar_visc_terms) {
+            start_scalar_visc_terms(fscalar,lscalar);
         }
-
-        // Compute viscous term
-        if (be_cn_theta != 1.0)
-            getViscTerms(visc_terms,fscalar,num_scalars,prev_time);
-        else
-            visc_terms.setVal(0.0,1);
+        AMREX_ASSERT(scalar_visc_terms->nComp() == num_scalars);
+        finish_visc_terms(*scalar_visc_terms,num_scalars,scalar_visc_exchanges,scalar_visc_diffusive);
+        const std::unique_ptr<MultiFab> visc_mf = std::move(scalar_visc_terms);
+        const MultiFab& visc_terms = *visc_mf;
 
 #ifdef _OPENMP
 #pragma omp parallel if (Gpu::notInLaunchRegion())
@@ -840,18 +888,7 @@ NavierStokes::scalar_update (Real dt,
     if (do_any_diffuse)
       scalar_diffusion_update(dt, first_scalar, last_scalar);
 
-    MultiFab&  S_new     = get_new_data(State_Type);
-//#ifdef AMREX_USE_EB
-//  set_body_state(S_new);
-//#endif
-    for (int sigma = first_scalar; sigma <= last_scalar; sigma++)
-    {
-       if (S_new.contains_nan(sigma,1,0))
-       {
-         Print() << "New scalar " << sigma << " contains Nans" << '\n';
-         exit(0);
-       }
-    }
+    health_check("scalar update", first_scalar, last_scalar-first_scalar+1, false);
 }
 
 void
@@ -867,7 +904,7 @@ NavierStokes::scalar_diffusion_update (Real dt,
     const Real prev_time = state[State_Type].prevTime();
     const Real curr_time = state[State_Type].curTime();
 
-    FillPatch(*this,get_old_data(State_Type),ng,prev_time,State_Type,Density,NUM_SCALARS,Density);
+    FillPatchState(get_old_data(State_Type),ng,prev_time,Density,NUM_SCALARS,Density);
     FillPatch(*this,get_new_data(State_Type),ng,curr_time,State_Type,Density,NUM_SCALARS,Density);
 
     auto Snc = std::make_unique<MultiFab>();
@@ -901,31 +938,51 @@ NavierStokes::scalar_diffusion_update (Real dt,
     MultiFab *alpha = nullptr;
     const int rhsComp = 0, alphaComp = 0, fluxComp  = 0;
 
-    FluxBoxes fb_fluxn  (this);
-    FluxBoxes fb_fluxnp1(this);
+    const int nflux = fuse_scalar_diffusion ? last_scalar - first_scalar + 1 : 1;
+    FluxBoxes fb_fluxn  (this, nflux);
+    FluxBoxes fb_fluxnp1(this, nflux);
     MultiFab** fluxn   = fb_fluxn.get();
     MultiFab** fluxnp1 = fb_fluxnp1.get();
 
-    Vector<int> diffuse_comp(1);
-
-    for (int sigma = first_scalar; sigma <= last_scalar; sigma++)
+    int ncomp = 1;
+    for (int sigma = first_scalar; sigma <= last_scalar; sigma += ncomp)
     {
+      //
+      // With fuse_scalar_diffusion, consecutive scalars with the same
+      // diffusion type and BCs are independent and diffused in one
+      // multi-component solve, so they share its halo exchanges and
+      // reductions.
+      //
+      ncomp = 1;
+      if (fuse_scalar_diffusion && is_diffusive[sigma])
+      {
+          while (sigma+ncomp <= last_scalar &&
+                 is_diffusive[sigma+ncomp] == is_diffusive[sigma] &&
+                 diffusionType[sigma+ncomp] == diffusionType[sigma] &&
+                 theBCs[sigma+ncomp] == theBCs[sigma])
+          {
+              ++ncomp;
+          }
+      }
+
       if (verbose) {
-          Print()<<"scalar_diffusion_update "<<sigma<<" of "<<last_scalar<<"\n";
+          Print()<<"scalar_diffusion_update "<<sigma;
+          if (ncomp > 1) Print()<<" to "<<sigma+ncomp-1;
+          Print()<<" of "<<last_scalar<<"\n";
       }
 
       if (is_diffusive[sigma])
       {
         if (be_cn_theta != 1)
         {
-          cmp_diffn = fb_diffn.define(this);
-          getDiffusivity(cmp_diffn, prev_time, sigma, 0, 1);
+          cmp_diffn = fb_diffn.define(this, ncomp);
+          getDiffusivity(cmp_diffn, prev_time, sigma, 0, ncomp);
         }
 
-        cmp_diffnp1 = fb_diffnp1.define(this);
-        getDiffusivity(cmp_diffnp1, curr_time, sigma, 0, 1);
+        cmp_diffnp1 = fb_diffnp1.define(this, ncomp);
+        getDiffusivity(cmp_diffnp1, curr_time, sigma, 0, ncomp);
 
-        diffuse_comp[0] = is_diffusive[sigma];
+        const Vector<int> diffuse_comp(ncomp, is_diffusive[sigma]);
         const int rho_flag = Diffusion::set_rho_flag(diffusionType[sigma]);
 
         const bool add_old_time_divFlux = true;
@@ -934,7 +991,7 @@ NavierStokes::scalar_diffusion_update (Real dt,
         const int Rho_comp = Density;
         const int bc_comp  = sigma;
 
-        diffusion->diffuse_scalar (Sn, Sn, Snp1, Snp1, sigma, 1, Rho_comp,
+        diffusion->diffuse_scalar (Sn, Sn, Snp1, Snp1, sigma, ncomp, Rho_comp,
                                    prev_time,curr_time,be_cn_theta,Rh,rho_flag,
                                    fluxn,fluxnp1,fluxComp,delta_rhs,rhsComp,
                                    alpha,alphaComp,
@@ -957,24 +1014,24 @@ NavierStokes::scalar_diffusion_update (Real dt,
 
                 if (level < parent->finestLevel())
                 {
-                    fluxes.define(fluxn[d]->boxArray(), fluxn[d]->DistributionMap(), 1, 0, MFInfo(), Factory());
+                    fluxes.define(fluxn[d]->boxArray(), fluxn[d]->DistributionMap(), ncomp, 0, MFInfo(), Factory());
                 }
 
                 for (MFIter fmfi(*fluxn[d]); fmfi.isValid(); ++fmfi)
                 {
                     const Box& ebox = (*fluxn[d])[fmfi].box();
 
-                    fluxtot.resize(ebox,1);
+                    fluxtot.resize(ebox,ncomp);
                     Elixir fdata_i = fluxtot.elixir();
 
                     auto const& ftot = fluxtot.array();
                     auto const& fn   = fluxn[d]->array(fmfi);
                     auto const& fnp1 = fluxnp1[d]->array(fmfi);
 
-                    amrex::ParallelFor(ebox, [ftot, fn, fnp1 ]
-                    AMREX_GPU_DEVICE (int i, int j, int k) noexcept
+                    amrex::ParallelFor(ebox, ncomp, [ftot, fn, fnp1 ]
+                    AMREX_GPU_DEVICE (int i, int j, int k, int n) noexcept
                     {
-                        ftot(i,j,k) = fn(i,j,k) + fnp1(i,j,k);
+                        ftot(i,j,k,n) = fn(i,j,k,n) + fnp1(i,j,k,n);
                     });
 
                     if (level < parent->finestLevel()) {
@@ -982,12 +1039,12 @@ NavierStokes::scalar_diffusion_update (Real dt,
                     }
 
                     if (level > 0) {
-                        getViscFluxReg().FineAdd(fluxtot,d,fmfi.index(),0,sigma,1,dt,RunOn::Gpu);
+                        getViscFluxReg().FineAdd(fluxtot,d,fmfi.index(),0,sigma,ncomp,dt,RunOn::Gpu);
                     }
                   } // mfi
 
                   if (level < parent->finestLevel()) {
-                    getLevel(level+1).getViscFluxReg().CrseInit(fluxes,d,0,sigma,1,-dt);
+                    getLevel(level+1).getViscFluxReg().CrseInit(fluxes,d,0,sigma,ncomp,-dt);
                   }
 
             } // d
@@ -1465,9 +1522,7 @@ NavierStokes::mac_sync ()
     Array<MultiFab*,AMREX_SPACEDIM> Ucorr;
     for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
     {
-      const BoxArray& edgeba = getEdgeBoxArray(idim);
-
-      Ucorr[idim]= new MultiFab(edgeba,dmap,1,nghost,MFInfo(),Factory());
+      Ucorr[idim] = workspace.acquire(idim,1,nghost);
     }
 
     sync_setup(DeltaSsync);
@@ -1486,10 +1541,10 @@ NavierStokes::mac_sync ()
                     NUM_STATE,be_cn_theta,
                     do_mom_diff);
     //
-    // Delete Ucorr; we're done with it.
+    // Give Ucorr back; we're done with it.
     //
     for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
-      delete Ucorr[idim];
+      workspace.release(Ucorr[idim]);
 
 
     //
@@ -1963,6 +2018,24 @@ NavierStokes::getViscTerms (MultiFab& visc_terms,
                             Real      time)
 {
     BL_PROFILE("NavierStokes::getViscTerms()");
+
+    Vector<std::unique_ptr<MultiFab>> exchanges;
+    const bool diffusive = post_visc_terms(visc_terms,src_comp,ncomp,time,exchanges);
+    finish_visc_terms(visc_terms,ncomp,exchanges,diffusive);
+}
+
+//
+// Compute the viscous terms block by block, posting the exchange of the
+// ghost cells of each block as soon as it is computed; returns whether
+// any component is diffusive. finish_visc_terms() completes them.
+//
+bool
+NavierStokes::post_visc_terms (MultiFab&                          visc_terms,
+                               int                                src_comp,
+                               int                                ncomp,
+                               Real                               time,
+                               Vector<std::unique_ptr<MultiFab>>& exchanges)
+{
     //
     // The logic below for selecting between scalar or tensor solves does
     // not allow for calling NavierStokes::getViscTerms with src_comp=Yvel
@@ -1985,6 +2058,17 @@ NavierStokes::getViscTerms (MultiFab& visc_terms,
 
     bool diffusive = false;
     //
+    // The ghost cells of each block of viscous terms are exchanged while
+    // the next block is being computed.
+    //
+    auto post_fill_boundary = [&] (int scomp, int n)
+    {
+        if (nGrow > 0) {
+            exchanges.push_back(std::make_unique<MultiFab>(visc_terms, amrex::make_alias, scomp, n));
+            exchanges.back()->FillBoundary_nowait(geom.periodicity());
+        }
+    };
+    //
     // Get Velocity Viscous Terms
     //
     if (src_comp == Xvel && !is_diffusive[Xvel])
@@ -2007,6 +2091,7 @@ NavierStokes::getViscTerms (MultiFab& visc_terms,
         auto* viscosityCC = (whichTime == AmrOldTime ? viscn_cc : viscnp1_cc);
 
         diffusion->getTensorViscTerms(visc_terms,time,viscosity,viscosityCC,0);
+        post_fill_boundary(0, AMREX_SPACEDIM);
     }
     //
     // Get Scalar Diffusive Terms
@@ -2032,18 +2117,31 @@ NavierStokes::getViscTerms (MultiFab& visc_terms,
 
                 diffusion->getViscTerms(visc_terms,src_comp,icomp,
                                         time,rho_flag,cmp_diffn,0);
+                post_fill_boundary(icomp-src_comp, 1);
             }
             else {
                 visc_terms.setVal(0.0,icomp-src_comp,1,nGrow);
             }
         }
     }
+    return diffusive;
+}
+
+void
+NavierStokes::finish_visc_terms (MultiFab&                          visc_terms,
+                                 int                                ncomp,
+                                 Vector<std::unique_ptr<MultiFab>>& exchanges,
+                                 bool                               diffusive)
+{
+    for (auto& mf : exchanges) {
+        mf->FillBoundary_finish();
+    }
+    exchanges.clear();
     //
     // Ensure consistent grow cells
     //
-    if (diffusive && nGrow > 0)
+    if (diffusive && visc_terms.nGrow() > 0)
     {
-        visc_terms.FillBoundary(0, ncomp, geom.periodicity());
         Extrapolater::FirstOrderExtrap(visc_terms, geom, 0, ncomp);
     }
 }
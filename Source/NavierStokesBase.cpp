@@ -106,6 +106,9 @@ Real NavierStokesBase::steady_tol         = 1.0e-10;
 int  NavierStokesBase::initial_iter       = false;
 int  NavierStokesBase::initial_step       = false;
 Real NavierStokesBase::dt_cutoff          = 0.0;
+Real NavierStokesBase::checkpoint_strt    = 0.0;
+Real NavierStokesBase::checkpoint_time    = 0.0;
+bool NavierStokesBase::diagnostics_suspended = false;
 int  NavierStokesBase::sum_interval       = -1;
 
 int  NavierStokesBase::radius_grow = 1;
@@ -122,6 +125,7 @@ Vector<Real> NavierStokesBase::visc_coef;
 Real        NavierStokesBase::visc_tol           = 1.0e-10;
 Real        NavierStokesBase::visc_abs_tol       = 1.0e-10;
 Real        NavierStokesBase::be_cn_theta        = 0.5;
+int         NavierStokesBase::fuse_scalar_diffusion = 0;
 
 int         NavierStokesBase::Tracer                    = -1;
 int         NavierStokesBase::Tracer2                   = -1;
@@ -190,8 +194,6 @@ int NavierStokesBase::average_in_checkpoint = -1;
 namespace
 {
     bool initialized = false;
-    int  dump_plane  = -1;
-    std::string dump_plane_name("SLABS/vel-");
     bool benchmarking = false;
 }
 
@@ -281,6 +283,8 @@ void NavierStokesBase::define_workspace()
         p_avg.define(P_grids,dmap,1,0,MFInfo(),Factory());
     }
 
+    workspace.define(this);
+
     rho_half.define (grids,dmap,1,1,MFInfo(),Factory());
     rho_ptime.define(grids,dmap,1,1,MFInfo(),Factory());
     rho_ctime.define(grids,dmap,1,1,MFInfo(),Factory());
@@ -430,8 +434,6 @@ NavierStokesBase::Initialize ()
 
     ParmParse pp("ns");
 
-    pp.query("dump_plane",dump_plane);
-
     pp.query("benchmarking",benchmarking);
 
     pp.query("v",verbose);
@@ -506,6 +508,7 @@ NavierStokesBase::Initialize ()
     if (be_cn_theta > 1.0 || be_cn_theta < .5) {
         amrex::Abort("NavierStokesBase::Initialize(): Must have be_cn_theta <= 1.0 && >= .5");
     }
+    pp.query("fuse_scalar_diffusion",fuse_scalar_diffusion);
     //
     // Set parameters dealing with how grids are treated at outflow boundaries.
     //
@@ -578,6 +581,66 @@ NavierStokesBase::Initialize ()
     }
 #endif
 
+    //
+    // Slice output; this also handles ns.dump_plane
+    //
+    read_slice_params();
+
+    //
+    // Point and line probes
+    //
+    read_probe_params();
+
+    //
+    // Streaming statistics
+    //
+    read_stats_params();
+
+    //
+    // Energy spectra
+    //
+    read_spectrum_params();
+
+    //
+    // Error-controlled time step selection
+    //
+    read_dt_control_params();
+
+    //
+    // Local pseudo-time stepping to steady state
+    //
+    read_steady_params();
+
+    //
+    // Error-bounded lossy compression of plotfiles
+    //
+    read_plot_compress_params();
+
+    //
+    // Plotfile regions, levels and precision
+    //
+    read_plotfile_params();
+
+    //
+    // Numerical health monitor
+    //
+    read_health_params();
+
+    //
+    // Adaptive regrid interval
+    //
+    read_regrid_params();
+
+    //
+    // Incremental checkpoints
+    //
+    read_delta_checkpoint_params();
+
+    //
+    // Multigrid solver autotuning
+    //
+    read_autotune_params();
+
     amrex::ExecOnFinalize(NavierStokesBase::Finalize);
 
     initialized = true;
@@ -617,6 +680,21 @@ NavierStokesBase::advance_setup (Real /*time*/,
 {
     BL_PROFILE("NavierStokesBase::advance_setup()");
 
+    if (level == 0 && !diagnostics_suspended) {
+        autotune_solvers();
+    }
+    //
+    // The old state is filled on first use, here in make_rho_prev_time;
+    // at level 0, its ghost cells are exchanged during the setup below.
+    //
+    S_old_fill.reset();
+    S_old_fill_ok = true;
+    divu_half.reset();
+
+    if (level == 0) {
+        start_old_state_fill();
+    }
+
     const int finest_level = parent->finestLevel();
 
     // Same for EB vs not.
@@ -685,6 +763,9 @@ NavierStokesBase::advance_setup (Real /*time*/,
     if (!initial_step && level > 0 && iteration == 1) {
         initRhoAvg(0.5/Real(ncycle));
     }
+    if (dt_control_active()) {
+        dt_control_save_old();
+    }
     //
     // Set up state multifabs for the advance.
     //
@@ -699,7 +780,6 @@ NavierStokesBase::advance_setup (Real /*time*/,
         // swaps pointers-- reuses space, but doesn't leave new with good data.
         state[k].swapTimeLevels(dt);
     }
-
     make_rho_prev_time();
 
     // refRatio==4 is not currently supported
@@ -748,6 +828,11 @@ NavierStokesBase::advance_cleanup (int /*iteration*/, int /*ncycle*/)
 {
     delete aofs;
     aofs = nullptr;
+
+    S_old_fill.reset();
+    S_old_fill_ok = false;
+    S_old_fill_pending = false;
+    divu_half.reset();
 }
 
 void
@@ -858,8 +943,30 @@ NavierStokesBase::checkPoint (const std::string& dir,
                               VisMF::How         how,
                               bool               dump_old)
 {
+    //
+    // Levels are written in order, so the last level ends the checkpoint.
+    //
+    if (level == 0) {
+        checkpoint_strt = ParallelDescriptor::second();
+    }
+
+    delta_checkpoint_hold(dir, dump_old);
+
     AmrLevel::checkPoint(dir, os, how, dump_old);
 
+    delta_checkpoint(dir, dump_old);
+
+    //
+    // Write out the buffered probe samples, and the end of the slice files,
+    // along with the checkpoint.
+    //
+    if (level == 0) {
+        flush_probes();
+        slice_checkpoint(dir);
+    }
+
+    stats_checkpoint(dir);
+
     if (avg_interval > 0)
     {
         VisMF::IO_Buffer io_buffer(VisMF::IO_Buffer_Size);
@@ -894,6 +1001,8 @@ NavierStokesBase::checkPoint (const std::string& dir,
             NSPC->Checkpoint(dir,the_ns_particle_file_name);
     }
 #endif
+
+    checkpoint_time = ParallelDescriptor::second() - checkpoint_strt;
 }
 
 void
@@ -962,10 +1071,35 @@ NavierStokesBase::computeNewDt (int                   finest_level,
 
     Real dt_0     = 1.0e+100;
     int  n_factor = 1;
-    for (i = 0; i <= finest_level; i++)
+    if (fixed_dt > 0.0)
+    {
+        for (i = 0; i <= finest_level; i++)
+        {
+            NavierStokesBase& adv_level = getLevel(i);
+            dt_min[i] = std::min(dt_min[i],adv_level.estTimeStep());
+        }
+    }
+    else
     {
-        NavierStokesBase& adv_level = getLevel(i);
-        dt_min[i] = std::min(dt_min[i],adv_level.estTimeStep());
+        //
+        // Reduce the estimates of all levels together.
+        //
+        Vector<Real> estdt(finest_level+1);
+        Vector<Vector<Real>> u_max(finest_level+1), f_max(finest_level+1);
+        for (i = 0; i <= finest_level; i++)
+        {
+            estdt[i] = getLevel(i).estTimeStepLocal(u_max[i],f_max[i]);
+        }
+
+        ParallelDescriptor::ReduceRealMin(estdt.dataPtr(),finest_level+1);
+
+        regrid_note_estimates(estdt);
+
+        for (i = 0; i <= finest_level; i++)
+        {
+            NavierStokesBase& adv_level = getLevel(i);
+            dt_min[i] = std::min(dt_min[i],adv_level.estTimeStepFinish(estdt[i],u_max[i],f_max[i]));
+        }
     }
 
     if (fixed_dt <= 0.0)
@@ -980,6 +1114,17 @@ NavierStokesBase::computeNewDt (int                   finest_level,
               dt_min[i] = std::min(dt_min[i],dt_level[i]);
           }
        }
+       else if (dt_control_factor() > 0.0)
+       {
+          //
+          // Limit dt's by the growth factor of the error controller
+          //
+          const Real dt_fac = dt_control_factor();
+          for (i = 0; i <= finest_level; i++)
+          {
+              dt_min[i] = std::min(dt_min[i],dt_fac*dt_level[i]);
+          }
+       }
        else
        {
           //
@@ -1371,62 +1516,98 @@ NavierStokesBase::estTimeStep ()
         return factor*fixed_dt;
     }
 
-    const Real  small         = 1.0e-8;
-    Real        estdt         = 1.0e+20;
+    Vector<Real> u_max, f_max;
 
-    MultiFab&   S_new         = get_new_data(State_Type);
+    Real estdt = estTimeStepLocal(u_max,f_max);
 
-    Vector<Real> u_max(AMREX_SPACEDIM);
-    Vector<Real> f_max(AMREX_SPACEDIM);
+    ParallelDescriptor::ReduceRealMin(estdt);
 
-    MultiFab& Gp = get_new_data(Gradp_Type);
+    return estTimeStepFinish(estdt,u_max,f_max);
+}
 
-    //
-    // Find local max of velocity
-    //
-    u_max = S_new.norm0({AMREX_D_DECL(0,1,2)},0,true,true);
+Real
+NavierStokesBase::estTimeStepLocal (Vector<Real>& u_max,
+                                    Vector<Real>& f_max)
+{
+    BL_PROFILE("NavierStokesBase::estTimeStepLocal()");
+
+    const Real  small         = 1.0e-8;
+    Real        estdt         = 1.0e+20;
+
+    const MultiFab& S_new     = get_new_data(State_Type);
+    const MultiFab& Gp        = get_new_data(Gradp_Type);
+    const Real      cur_time  = state[State_Type].curTime();
 
     //
-    // Compute forcing terms: in this case this means external forces and grad(p)
-    // Viscous terms not included since Crack-Nicholson is unconditionally stable
-    // so no need to account for explicit part of viscous term
+    // Find the local max of velocity and of the forcing terms in a single
+    // pass. Here the forcing means external forces and grad(p); viscous
+    // terms are not included since Crank-Nicolson is unconditionally
+    // stable, so no need to account for the explicit part of the viscous
+    // term. The forces are only held per tile.
     //
-    MultiFab tforces(grids,dmap,AMREX_SPACEDIM,0,MFInfo(),Factory());
+    ReduceOps<AMREX_D_DECL(ReduceOpMax,ReduceOpMax,ReduceOpMax),
+              AMREX_D_DECL(ReduceOpMax,ReduceOpMax,ReduceOpMax)> reduce_op;
+    ReduceData<AMREX_D_DECL(Real,Real,Real),
+               AMREX_D_DECL(Real,Real,Real)> reduce_data(reduce_op);
+    using ReduceTuple = typename decltype(reduce_data)::Type;
 
 #ifdef AMREX_USE_OMP
 #pragma omp parallel if (Gpu::notInLaunchRegion())
 #endif
     for (MFIter mfi(S_new,TilingIfNotGPU()); mfi.isValid(); ++mfi)
     {
-       const auto& bx          = mfi.tilebox();
-       const auto  cur_time    = state[State_Type].curTime();
-       auto& tforces_fab       = tforces[mfi];
+       const auto& bx = mfi.tilebox();
+
+       FArrayBox tforces(bx, AMREX_SPACEDIM, The_Async_Arena());
 
        if (getForceVerbose) {
            amrex::Print() << "---" << '\n'
                           << "H - est Time Step:" << '\n'
                           << "Calling getForce..." << '\n';
        }
-       getForce(tforces_fab,bx,0,AMREX_SPACEDIM,cur_time,S_new[mfi],S_new[mfi],Density,mfi);
+       getForce(tforces,bx,0,AMREX_SPACEDIM,cur_time,S_new[mfi],S_new[mfi],Density,mfi);
 
-       const auto& rho   = S_new.array(mfi,Density);
-       const auto& gradp = Gp.array(mfi);
-       const auto& force = tforces.array(mfi);
-       amrex::ParallelFor(bx, [rho, gradp, force]
-       AMREX_GPU_DEVICE(int i, int j, int k) noexcept
+       const auto& vel   = S_new.const_array(mfi);
+       const auto& rho   = S_new.const_array(mfi,Density);
+       const auto& gradp = Gp.const_array(mfi);
+       const auto& force = tforces.const_array();
+#ifdef AMREX_USE_EB
+       const auto& vfrac = EBFactory().getVolFrac().const_array(mfi);
+#endif
+
+       reduce_op.eval(bx, reduce_data, [=]
+       AMREX_GPU_DEVICE(int i, int j, int k) noexcept -> ReduceTuple
        {
-          Real rho_inv = 1.0/rho(i,j,k);
-          for (int n = 0; n < AMREX_SPACEDIM; n++) {
-             force(i,j,k,n) -= gradp(i,j,k,n);
-             force(i,j,k,n) *= rho_inv;
+#ifdef AMREX_USE_EB
+          if (vfrac(i,j,k) == 0.0) {
+             return { AMREX_D_DECL(0.,0.,0.), AMREX_D_DECL(0.,0.,0.) };
           }
+#endif
+          Real rho_inv = 1.0/rho(i,j,k);
+          return { AMREX_D_DECL(amrex::Math::abs(vel(i,j,k,0)),
+                                amrex::Math::abs(vel(i,j,k,1)),
+                                amrex::Math::abs(vel(i,j,k,2))),
+                   AMREX_D_DECL(amrex::Math::abs((force(i,j,k,0)-gradp(i,j,k,0))*rho_inv),
+                                amrex::Math::abs((force(i,j,k,1)-gradp(i,j,k,1))*rho_inv),
+                                amrex::Math::abs((force(i,j,k,2)-gradp(i,j,k,2))*rho_inv)) };
        });
     }
 
-    //
-    // Find local max of tforces
-    //
-    f_max = tforces.norm0({AMREX_D_DECL(0,1,2)},0,true,true);
+    ReduceTuple hv = reduce_data.value(reduce_op);
+
+    u_max.resize(AMREX_SPACEDIM);
+    f_max.resize(AMREX_SPACEDIM);
+    AMREX_D_TERM(u_max[0] = amrex::get<0>(hv);,
+                 u_max[1] = amrex::get<1>(hv);,
+                 u_max[2] = amrex::get<2>(hv););
+    AMREX_D_TERM(f_max[0] = amrex::get<AMREX_SPACEDIM  >(hv);,
+                 f_max[1] = amrex::get<AMREX_SPACEDIM+1>(hv);,
+                 f_max[2] = amrex::get<AMREX_SPACEDIM+2>(hv););
+    for (int idim = 0; idim < AMREX_SPACEDIM; ++idim)
+    {
+        u_max[idim] = std::max(u_max[idim], Real(0.0));
+        f_max[idim] = std::max(f_max[idim], Real(0.0));
+    }
 
     //
     // Compute local estdt
@@ -1446,11 +1627,17 @@ NavierStokesBase::estTimeStep ()
         }
     }
 
-    //
-    // Reduce estimated dt by CFL factor and find global min
-    //
-    ParallelDescriptor::ReduceRealMin(estdt);
+    return estdt;
+}
 
+//
+// Scale the reduced estimate by the CFL factor, or fall back on init_dt.
+//
+Real
+NavierStokesBase::estTimeStepFinish (Real          estdt,
+                                     Vector<Real>& u_max,
+                                     Vector<Real>& f_max)
+{
     if ( estdt < 1.0e+20) {
       //
       // timestep estimation successful
@@ -1750,6 +1937,10 @@ NavierStokesBase::init (AmrLevel &old)
             FillPatch(old,Dsdt_new,0,cur_time,Dsdt_Type,0,1);
         }
     }
+
+    if (!diagnostics_suspended) {
+        stats_regrid(oldns);
+    }
 }
 
 //
@@ -1803,6 +1994,10 @@ NavierStokesBase::init ()
         if (have_dsdt)
             FillCoarsePatch(get_new_data(Dsdt_Type),0,cur_time,Dsdt_Type,0,1);
     }
+
+    if (!diagnostics_suspended) {
+        stats_regrid(nullptr);
+    }
 }
 
 void
@@ -2043,12 +2238,94 @@ NavierStokesBase::level_sync (int crse_iteration)
     BL_PROFILE_REGION_STOP("R::NavierStokesBase::level_sync()");
 }
 
+//
+// Start filling the old state of the advance about to be set up: at
+// level 0, where the fill is a copy and an exchange of ghost cells, copy
+// the state that becomes the old one and post the exchange, which
+// get_old_state_filled() completes.
+//
+void
+NavierStokesBase::start_old_state_fill ()
+{
+    AMREX_ASSERT(level == 0 && S_old_fill_ok && !S_old_fill);
+
+    S_old_fill = std::make_unique<MultiFab>(grids,dmap,NUM_STATE,nghost_state(),
+                                            MFInfo(),Factory());
+    MultiFab::Copy(*S_old_fill,get_new_data(State_Type),0,0,NUM_STATE,0);
+    S_old_fill->FillBoundary_nowait(0,NUM_STATE,S_old_fill->nGrowVect(),geom.periodicity());
+    S_old_fill_pending = true;
+}
+
+const MultiFab&
+NavierStokesBase::get_old_state_filled ()
+{
+    AMREX_ALWAYS_ASSERT(S_old_fill_ok);
+
+    if (S_old_fill_pending)
+    {
+        BL_PROFILE("NavierStokesBase::get_old_state_filled()");
+
+        S_old_fill->FillBoundary_finish();
+        S_old_fill_pending = false;
+
+        StateDataPhysBCFunct physbc(state[State_Type],0,geom);
+        physbc(*S_old_fill,0,NUM_STATE,S_old_fill->nGrowVect(),state[State_Type].prevTime(),0);
+    }
+    else if (!S_old_fill)
+    {
+        BL_PROFILE("NavierStokesBase::get_old_state_filled()");
+
+        const Real prev_time = state[State_Type].prevTime();
+
+        S_old_fill = std::make_unique<MultiFab>(grids,dmap,NUM_STATE,nghost_state(),
+                                                MFInfo(),Factory());
+        FillPatch(*this,*S_old_fill,nghost_state(),prev_time,State_Type,0,NUM_STATE);
+    }
+    return *S_old_fill;
+}
+
+const MultiFab&
+NavierStokesBase::get_divu_half_time (Real dt)
+{
+    AMREX_ALWAYS_ASSERT(S_old_fill_ok);
+
+    if (!divu_half)
+    {
+        const Real prev_time = state[State_Type].prevTime();
+
+        divu_half.reset(getDivCond(nghost_force(),prev_time));
+        std::unique_ptr<MultiFab> dsdt(getDsdt(nghost_force(),prev_time));
+        MultiFab::Saxpy(*divu_half, 0.5*dt, *dsdt, 0, 0, 1, nghost_force());
+    }
+    return *divu_half;
+}
+
+void
+NavierStokesBase::FillPatchState (MultiFab& mf,
+                                  int       ng,
+                                  Real      time,
+                                  int       scomp,
+                                  int       ncomp,
+                                  int       dcomp)
+{
+    if (S_old_fill_ok && ng <= nghost_state() &&
+        which_time(State_Type,time) == AmrOldTime &&
+        mf.boxArray() == grids && mf.DistributionMap() == dmap)
+    {
+        MultiFab::Copy(mf,get_old_state_filled(),scomp,dcomp,ncomp,ng);
+    }
+    else
+    {
+        FillPatch(*this,mf,ng,time,State_Type,scomp,ncomp,dcomp);
+    }
+}
+
 void
 NavierStokesBase::make_rho_prev_time ()
 {
     const Real prev_time = state[State_Type].prevTime();
 
-    FillPatch(*this,rho_ptime,1,prev_time,State_Type,Density,1,0);
+    FillPatchState(rho_ptime,1,prev_time,Density,1,0);
 
 #ifdef AMREX_USE_EB
     EB_set_covered(rho_ptime,COVERED_VAL);
@@ -2216,6 +2493,12 @@ NavierStokesBase::okToContinue ()
    //
    int okLevel = (level > 0) ? true : (parent->dtLevel(0) > dt_cutoff);
 
+   //
+   // Stop after a dry run of the solver autotuning.
+   //
+   if (autotune_stop_requested())
+      return false;
+
    if (stop_when_steady)
       //
       // If stop_when_steady is enabled, also check that we haven't reached
@@ -2233,6 +2516,10 @@ NavierStokesBase::steadyState()
         return false; // If nothing to compare to, must not yet be steady :)
     }
 
+    if (steady_local_dt_active()) {
+        return steady_residual_converged();
+    }
+
     MultiFab&   u_old = get_old_data(State_Type);
     MultiFab&   u_new = get_new_data(State_Type);
 
@@ -2445,6 +2732,8 @@ void
 NavierStokesBase::post_regrid (int lbase,
                                int /*new_finest*/)
 {
+    invalidate_probe_locations();
+
 #ifdef AMREX_PARTICLES
     if (NSPC && level == lbase)
     {
@@ -2521,6 +2810,13 @@ NavierStokesBase::post_restart ()
     }
   }
 
+  if (!diagnostics_suspended) {
+      stats_restart(parent->theRestartFile());
+      if (level == 0) {
+          slice_restart(parent->theRestartFile());
+      }
+  }
+
 #ifdef AMREX_USE_TURBULENT_FORCING
   //
   // Initialize data structures used for homogenous isentropic forced turbulence.
@@ -2553,11 +2849,10 @@ NavierStokesBase::post_timestep (int crse_iteration)
     post_timestep_particle (crse_iteration);
 #endif
 
-    if (level == parent->finestLevel())
-    {
-        delete [] u_mac;
-        u_mac = nullptr;
-    }
+    //
+    // u_mac and the workspace buffers are kept until the next regrid.
+    //
+    workspace.report(level, verbose > 1);
 
     if (do_reflux && level < finest_level)
         reflux();
@@ -2593,38 +2888,33 @@ NavierStokesBase::post_timestep (int crse_iteration)
 
     if (level > 0) incrPAvg();
 
-    if (level == 0 && dump_plane >= 0)
-    {
-        Box bx = geom.Domain();
-
-        AMREX_ASSERT(bx.bigEnd(AMREX_SPACEDIM-1) >= dump_plane);
-
-        bx.setSmall(AMREX_SPACEDIM-1, dump_plane);
-        bx.setBig  (AMREX_SPACEDIM-1, dump_plane);
-
-        BoxArray ba(bx);
-        DistributionMapping dm{ba};
+    const bool diagnostics = level == 0 && !diagnostics_suspended;
 
-        MultiFab mf(ba, dm, AMREX_SPACEDIM, 0, MFInfo(), Factory());
-
-        mf.ParallelCopy(get_new_data(State_Type), Xvel, 0, AMREX_SPACEDIM);
+    if (diagnostics && slice_output_due(parent->levelSteps(0),
+                                        state[State_Type].curTime(),
+                                        parent->dtLevel(0)))
+    {
+        write_slices();
+    }
 
-        if (ParallelDescriptor::MyProc() == mf.DistributionMap()[0])
-        {
-            char buf[64];
-            sprintf(buf, "%14.12e", state[State_Type].curTime());
+    if (diagnostics && probe_sample_due(parent->levelSteps(0)))
+    {
+        sample_probes();
+    }
 
-            std::string name(dump_plane_name);
-            name += buf;
-            name += ".fab";
+    if (diagnostics && stats_sample_due(parent->levelSteps(0)))
+    {
+        stats_sample();
+    }
 
-            std::ofstream ofs;
-            ofs.open(name.c_str(),std::ios::out|std::ios::trunc|std::ios::binary);
-            if (!ofs.good())
-                amrex::FileOpenFailed(name);
+    if (diagnostics && spectrum_due(parent->levelSteps(0)))
+    {
+        compute_spectrum();
+    }
 
-            mf[0].writeOn(ofs);
-        }
+    if (level == 0 && dt_control_active())
+    {
+        dt_control_estimate();
     }
 
     if (avg_interval > 0)
@@ -2711,6 +3001,10 @@ NavierStokesBase::restart (Amr&          papa,
 
     AmrLevel::restart(papa,is,bReadSpecial);
 
+    if (level == 0) {
+        regrid_reset();
+    }
+
     if ( gradp_in_checkpoint==0 )
     {
       Print()<<"WARNING! GradP not found in checkpoint file. Recomputing from Pressure."
@@ -3374,19 +3668,17 @@ NavierStokesBase::velocity_advection (Real dt)
 
     const Real  prev_time      = state[State_Type].prevTime();
 
-    std::unique_ptr<MultiFab> divu_fp(getDivCond(nghost_force(),prev_time));
-
     MultiFab forcing_term( grids, dmap, AMREX_SPACEDIM, nghost_force(), MFInfo(),Factory());
     forcing_term.setVal(0.0);
 
-    FillPatchIterator U_fpi(*this,forcing_term, nghost_state(),prev_time,State_Type,Xvel,AMREX_SPACEDIM);
-    MultiFab& Umf=U_fpi.get_mf();
+    const MultiFab& S_fill = get_old_state_filled();
+    const MultiFab Umf(S_fill, amrex::make_alias, Xvel, AMREX_SPACEDIM);
 
     //
     // S_term is the state we are solving for: either velocity or momentum
     //
     MultiFab raii;
-    MultiFab* S_term;
+    const MultiFab* S_term;
     if (do_mom_diff) {
         raii.define(grids, dmap, AMREX_SPACEDIM, nghost_state(), MFInfo(), Factory());
         S_term = &raii;
@@ -3396,16 +3688,13 @@ NavierStokesBase::velocity_advection (Real dt)
 
     if (do_mom_diff)
     {
-        FillPatchIterator Rho_fpi(*this,forcing_term,nghost_state(),prev_time,State_Type,Density,1);
-        MultiFab& Rmf=Rho_fpi.get_mf();
-
         for (MFIter U_mfi(Umf,TilingIfNotGPU()); U_mfi.isValid(); ++U_mfi)
         {
             auto const state_bx = U_mfi.growntilebox(nghost_state());
 
-            auto const& dens = Rmf.const_array(U_mfi); //Previous time, nghost_state() grow cells filled
+            auto const& dens = S_fill.const_array(U_mfi,Density); //Previous time, nghost_state() grow cells filled
             auto const& vel  = Umf.const_array(U_mfi);
-            auto const& st   = S_term->array(U_mfi);
+            auto const& st   = raii.array(U_mfi);
 
             amrex::ParallelFor(state_bx, AMREX_SPACEDIM, [ dens, vel, st ]
             AMREX_GPU_DEVICE (int i, int j, int k, int n) noexcept
@@ -3415,14 +3704,10 @@ NavierStokesBase::velocity_advection (Real dt)
 
     MultiFab& Gp = get_old_data(Gradp_Type);
 
-    FillPatchIterator S_fpi(*this,forcing_term,nghost_force(),prev_time,State_Type,Density,NUM_SCALARS);
-    MultiFab& Smf=S_fpi.get_mf();
+    const MultiFab Smf(S_fill, amrex::make_alias, Density, NUM_SCALARS);
 
-    // Get divu to time n+1/2
-    {
-        std::unique_ptr<MultiFab> dsdt(getDsdt(nghost_force(),prev_time));
-        MultiFab::Saxpy(*divu_fp, 0.5*dt, *dsdt, 0, 0, 1, nghost_force());
-    }
+    // divu at time n+1/2, shared with scalar_advection
+    const MultiFab& divu_fp = get_divu_half_time(dt);
 
     MultiFab visc_terms(grids,dmap,AMREX_SPACEDIM,nghost_force(),MFInfo(),Factory());
     if (be_cn_theta != 1.0)
@@ -3466,7 +3751,7 @@ NavierStokesBase::velocity_advection (Real dt)
         });
     }
 
-    ComputeAofs( Xvel, AMREX_SPACEDIM, *S_term, 0, forcing_term, *divu_fp, true, dt );
+    ComputeAofs( Xvel, AMREX_SPACEDIM, *S_term, 0, forcing_term, divu_fp, true, dt );
 }
 
 //
@@ -3507,16 +3792,7 @@ NavierStokesBase::velocity_update (Real dt)
     else
         initial_velocity_diffusion_update(dt);
 
-    MultiFab&  S_new     = get_new_data(State_Type);
-
-    for (int sigma = 0; sigma < AMREX_SPACEDIM; sigma++)
-    {
-       if (S_new.contains_nan(sigma,1,0))
-       {
-          amrex::Print() << "New velocity " << sigma << " contains Nans" << '\n';
-          exit(0);
-       }
-    }
+    health_check("velocity update", Xvel, AMREX_SPACEDIM, true);
 }
 
 void
@@ -3626,32 +3902,6 @@ NavierStokesBase::velocity_advection_update (Real dt)
         });
     }
 }
-
-    for (int sigma = 0; sigma < AMREX_SPACEDIM; sigma++)
-    {
-       if (U_old.contains_nan(sigma,1,0))
-       {
-         amrex::Print() << "VAU: Old velocity " << sigma << " contains Nans" << std::endl;
-
-         IntVect mpt(AMREX_D_DECL(-100,100,-100));
-         for (MFIter mfi(U_old); mfi.isValid(); ++mfi){
-           const Box& bx = mfi.tilebox();
-           if ( U_old[mfi].contains_nan<RunOn::Device>(bx, sigma, 1, mpt) )
-             amrex::Print() << " Nans at " << mpt << std::endl;
-         }
-       }
-       if (U_new.contains_nan(sigma,1,0))
-       {
-         amrex::Print() << "VAU: New velocity " << sigma << " contains Nans" << std::endl;
-
-         IntVect mpt(AMREX_D_DECL(-100,100,-100));
-         for (MFIter mfi(U_new); mfi.isValid(); ++mfi){
-           const Box& bx = mfi.tilebox();
-           if ( U_new[mfi].contains_nan<RunOn::Device>(bx, sigma, 1, mpt) )
-             amrex::Print() << " Nans at " << mpt << std::endl;
-         }
-       }
-    }
 }
 
 void
@@ -3991,7 +4241,15 @@ NavierStokesBase::ParticleDerive (const std::string& name,
             MultiFab temp_dat(grids,dmap,1,0, MFInfo(), Factory());
             temp_dat.setVal(0);
             NSPC->Increment(temp_dat,level);
-            MultiFab::Copy(mf,temp_dat,0,dcomp,1,0);
+            //
+            // mf may be on boxes other than the level grids, e.g. for a
+            // plotfile region.
+            //
+            if (mf.boxArray() == grids && mf.DistributionMap() == dmap) {
+                MultiFab::Copy(mf,temp_dat,0,dcomp,1,0);
+            } else {
+                mf.ParallelCopy(temp_dat,0,dcomp,1);
+            }
         }
         else if (name == "total_particle_count")
         {
@@ -4040,7 +4298,7 @@ NavierStokesBase::ParticleDerive (const std::string& name,
 
                 temp_dat.clear();
 
-                MultiFab dat(grids,dmap,1,0,MFInfo(),Factory());
+                MultiFab dat(mf.boxArray(),mf.DistributionMap(),1,0);
                 dat.setVal(0);
                 dat.ParallelCopy(ctemp_dat);
 
@@ -4248,6 +4506,94 @@ NavierStokesBase::printMaxValues (bool new_data)
     printMaxGp(new_data);
 }
 
+int
+NavierStokesBase::derive_num_comp (const std::string& name)
+{
+    int state_indx, comp;
+    if (isStateVariable(name, state_indx, comp)) {
+        return 1;
+    }
+
+    const DeriveRec* rec = derive_lst.get(name);
+    if (!rec) {
+        amrex::Abort("NavierStokesBase::derive_num_comp(): unknown variable " + name);
+    }
+    if (!rec->deriveType().cellCentered()) {
+        amrex::Abort("NavierStokesBase::derive_num_comp(): " + name + " is not cell-centered");
+    }
+    return rec->numDerive();
+}
+
+std::unique_ptr<MultiFab>
+NavierStokesBase::derive_on_region (const Vector<std::string>& names,
+                                    Real                       time,
+                                    const Box&                 region)
+{
+    BL_PROFILE("NavierStokesBase::derive_on_region()");
+
+    //
+    // Keep the owner of each grid so that the fill below is local.
+    //
+    BoxList     bl;
+    Vector<int> owners;
+    for (int i = 0; i < grids.size(); ++i)
+    {
+        const Box isect = grids[i] & region;
+        if (isect.ok())
+        {
+            bl.push_back(isect);
+            owners.push_back(dmap[i]);
+        }
+    }
+
+    if (bl.isEmpty()) {
+        return nullptr;
+    }
+
+    return derive_on_boxes(names, time, BoxArray(std::move(bl)),
+                           DistributionMapping(std::move(owners)));
+}
+
+std::unique_ptr<MultiFab>
+NavierStokesBase::derive_on_boxes (const Vector<std::string>& names,
+                                   Real                       time,
+                                   const BoxArray&            ba,
+                                   const DistributionMapping& dm)
+{
+    BL_PROFILE("NavierStokesBase::derive_on_boxes()");
+
+    int ncomp = 0;
+    for (const auto& name : names) {
+        ncomp += derive_num_comp(name);
+    }
+
+    auto mf = std::make_unique<MultiFab>(ba, dm, ncomp, 0);
+
+#ifdef AMREX_USE_EB
+    //
+    // The EB factory only knows the level grids, so derive all the
+    // variables on the whole level and copy the boxes out at once.
+    //
+    MultiFab full(grids, dmap, ncomp, 0, MFInfo(), Factory());
+    MultiFab& dst = full;
+#else
+    MultiFab& dst = *mf;
+#endif
+
+    int dcomp = 0;
+    for (const auto& name : names)
+    {
+        derive(name, time, dst, dcomp);
+        dcomp += derive_num_comp(name);
+    }
+
+#ifdef AMREX_USE_EB
+    mf->ParallelCopy(full, 0, 0, ncomp);
+#endif
+
+    return mf;
+}
+
 
 //
 // Correct a conservatively-advected scalar for under-over shoots.
@@ -4396,8 +4742,10 @@ NavierStokesBase::predict_velocity (Real  dt)
    //
    MultiFab visc_terms(grids,dmap,nComp,nghost_force(),MFInfo(), Factory());
 
-   FillPatchIterator U_fpi(*this,visc_terms,nghost_state(),prev_time,State_Type,Xvel,AMREX_SPACEDIM);
-   MultiFab& Umf=U_fpi.get_mf();
+   const MultiFab& S_fill = get_old_state_filled();
+
+   MultiFab Umf(grids,dmap,nComp,nghost_state(),MFInfo(),Factory());
+   MultiFab::Copy(Umf,S_fill,Xvel,0,nComp,nghost_state());
 
    // Floor small values of states to be extrapolated
    floor(Umf);
@@ -4432,8 +4780,7 @@ NavierStokesBase::predict_velocity (Real  dt)
            visc_terms.setVal(0.0);
        }
 
-       FillPatchIterator S_fpi(*this,visc_terms,nghost_state(),prev_time,State_Type,Density,NUM_SCALARS);
-       MultiFab& Smf=S_fpi.get_mf();
+       const MultiFab Smf(S_fill, amrex::make_alias, Density, NUM_SCALARS);
 
        MultiFab forcing_term( grids, dmap, AMREX_SPACEDIM, nghost_force() );
 
@@ -4568,12 +4915,16 @@ NavierStokesBase::ComputeAofs ( int comp, int ncomp,
     // 2nd order slopes use i+/-1 => S needs 2 ghost cells (MOL)
     // 4th order slopes use i+/-2 => S needs 3 ghost cells (Godunov)
     //
+    // The fluxes and edge states are aliases of workspace buffers.
+    //
     int nghost = 0;
+    Array<MultiFab*, AMREX_SPACEDIM> flux_buf, edge_buf;
     for (int i = 0; i < AMREX_SPACEDIM; ++i)
     {
-        const BoxArray& ba = getEdgeBoxArray(i);
-        cfluxes[i].define(ba, dmap, ncomp, nghost, MFInfo(), Factory());
-        edgestate[i].define(ba, dmap, ncomp, nghost, MFInfo(), Factory());
+        flux_buf[i] = workspace.acquire(i, ncomp, nghost);
+        edge_buf[i] = workspace.acquire(i, ncomp, nghost);
+        cfluxes[i]   = MultiFab(*flux_buf[i], amrex::make_alias, 0, ncomp);
+        edgestate[i] = MultiFab(*edge_buf[i], amrex::make_alias, 0, ncomp);
     }
 
     bool do_crse_add = true;
@@ -4588,6 +4939,12 @@ NavierStokesBase::ComputeAofs ( int comp, int ncomp,
                 is_velocity, dt,
                 /*is_sync*/ false, /*sync fluxing velocity Ucorr*/ {},
                 do_crse_add, do_fine_add);
+
+    for (int i = 0; i < AMREX_SPACEDIM; ++i)
+    {
+        workspace.release(flux_buf[i]);
+        workspace.release(edge_buf[i]);
+    }
 }
 
 void
@@ -4850,8 +5207,6 @@ NavierStokesBase::ComputeAofs ( MultiFab& advc, int a_comp, // Advection term "A
     // EB step 5: Redistribute the advective update stashed in update_MF.
     //
 #ifdef AMREX_USE_EB
-    update_MF.FillBoundary(geom.periodicity());
-
     //
     // Define the "state" for StateRedistribution.
     //
@@ -4897,11 +5252,7 @@ NavierStokesBase::ComputeAofs ( MultiFab& advc, int a_comp, // Advection term "A
                    level_mask_covered, level_mask_notcovered, level_mask_physbnd, level_mask_interior);
     }
 
-#ifdef _OPENMP
-#pragma omp parallel if (Gpu::notInLaunchRegion())
-#endif
-    // for (MFIter mfi(advc, TilingIfNotGPU()); mfi.isValid(); ++mfi)
-    for (MFIter mfi(advc, false); mfi.isValid(); ++mfi)
+    auto redistribute_and_reflux = [&] (MFIter const& mfi)
     {
         AMREX_D_TERM( const auto& fx_fab = (cfluxes[0])[mfi];,
                       const auto& fy_fab = (cfluxes[1])[mfi];,
@@ -5095,7 +5446,34 @@ NavierStokesBase::ComputeAofs ( MultiFab& advc, int a_comp, // Advection term "A
                                dxDp, sync_factor*dt, flux_comp, state_indx, ncomp, amrex::RunOn::Device);
         } // do_reflux && (level > 0)
 #endif
-    } // mfi
+    };
+
+#ifdef AMREX_USE_EB
+    //
+    // Boxes away from the EB do not read the ghost cells of update_MF, so
+    // they are done while those are being exchanged. This is the only
+    // exchange in here: without EB the update is local, and the inputs S
+    // and u_mac come with their ghost cells already filled.
+    //
+    auto needs_halo = [&] (MFIter const& mfi)
+    {
+        auto const& bx      = mfi.tilebox();
+        auto const& flagfab = ebfact.getMultiEBCellFlagFab()[mfi];
+        return flagfab.getType(bx) != FabType::covered &&
+               flagfab.getType(amrex::grow(bx,4)) != FabType::regular;
+    };
+
+    FillBoundaryOverlap(update_MF, 0, ncomp, geom.periodicity(), false,
+                        needs_halo, redistribute_and_reflux);
+#else
+#ifdef _OPENMP
+#pragma omp parallel if (Gpu::notInLaunchRegion())
+#endif
+    for (MFIter mfi(advc, false); mfi.isValid(); ++mfi)
+    {
+        redistribute_and_reflux(mfi);
+    }
+#endif
 }
 
 
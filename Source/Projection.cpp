@@ -57,12 +57,8 @@ Projection::Initialize ()
     pp.query("do_outflow_bcs",      do_outflow_bcs);
     pp.query("rho_wgt_vel_proj",    rho_wgt_vel_proj);
 
-    pp.query("agglomeration",       agglomeration);
-    pp.query("consolidation",       consolidation);
-    pp.query("max_fmg_iter",        max_fmg_iter);
-    pp.query("use_gauss_seidel",    use_gauss_seidel);
-    pp.query("use_harmonic_average", use_harmonic_average);
-    pp.query("mg_max_coarsening_level", max_coarsening_level);
+    read_mg_params();
+
 
 
     // Abort if old verbose flag is found
@@ -85,6 +81,22 @@ Projection::Initialize ()
     initialized = true;
 }
 
+//
+// Multigrid options; also called again after solver autotuning.
+//
+void
+Projection::read_mg_params ()
+{
+    ParmParse pp("nodal_proj");
+
+    pp.query("agglomeration",       agglomeration);
+    pp.query("consolidation",       consolidation);
+    pp.query("max_fmg_iter",        max_fmg_iter);
+    pp.query("use_gauss_seidel",    use_gauss_seidel);
+    pp.query("use_harmonic_average", use_harmonic_average);
+    pp.query("mg_max_coarsening_level", max_coarsening_level);
+}
+
 void
 Projection::Finalize ()
 {
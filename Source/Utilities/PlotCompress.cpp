@@ -0,0 +1,540 @@
+#include "PlotCompress.H"
+
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Utility.H>
+#include <AMReX_VisMF.H>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <sstream>
+
+using namespace amrex;
+
+namespace
+{
+    const std::string header_version("IAMR-PlotCompress-V1");
+
+    //
+    // Residuals in (-max_residual, max_residual) are Huffman coded; the
+    // others are escaped and stored as they are.
+    //
+    constexpr std::int64_t  max_residual = 1 << 15;
+    constexpr std::uint32_t escape       = 2*max_residual;
+    constexpr int           max_code_len = 32;
+
+    // Largest |v|/(2 eb) quantized, so that the predictor cannot overflow.
+    constexpr Real max_quantum = 1.e15;
+
+    enum : char { stored_exactly = 0, quantized = 1 };
+
+    template <typename T>
+    void put (std::vector<char>& out, const T& v)
+    {
+        const char* p = reinterpret_cast<const char*>(&v);
+        out.insert(out.end(), p, p+sizeof(T));
+    }
+
+    template <typename T>
+    T get (const char*& in)
+    {
+        T v;
+        std::memcpy(&v, in, sizeof(T));
+        in += sizeof(T);
+        return v;
+    }
+
+    std::uint32_t zigzag (std::int64_t r)
+    {
+        return static_cast<std::uint32_t>(r >= 0 ? 2*r : -2*r-1);
+    }
+
+    std::int64_t unzigzag (std::uint32_t s)
+    {
+        return (s & 1) ? -std::int64_t(s/2)-1 : std::int64_t(s/2);
+    }
+
+    //
+    // Lorenzo prediction of q(i,j,k) from its lower neighbors in a box of
+    // nx*ny*nz values, x fastest; neighbors outside the box are 0.
+    //
+    struct Lorenzo
+    {
+        Long nx, ny, nz;
+
+        std::int64_t operator() (const std::int64_t* q, Long i, Long j, Long k) const
+        {
+            auto at = [&] (Long a, Long b, Long c) -> std::int64_t {
+                return (a < 0 || b < 0 || c < 0) ? 0 : q[a + nx*(b + ny*c)];
+            };
+            return at(i-1,j,k) + at(i,j-1,k) + at(i,j,k-1)
+                 - at(i-1,j-1,k) - at(i-1,j,k-1) - at(i,j-1,k-1)
+                 + at(i-1,j-1,k-1);
+        }
+    };
+
+    //
+    // Code lengths of a Huffman code for the given (nonzero) frequencies,
+    // at most max_code_len bits.
+    //
+    std::vector<int> huffman_lengths (std::vector<std::uint64_t> freq)
+    {
+        const int n = static_cast<int>(freq.size());
+        std::vector<int> len(n, 1);
+        if (n <= 1) return len;
+
+        while (true)
+        {
+            using Node = std::pair<std::uint64_t,int>;
+            std::priority_queue<Node, std::vector<Node>, std::greater<>> heap;
+            std::vector<int> parent(2*n-1, -1);
+            for (int i = 0; i < n; ++i) heap.push({freq[i], i});
+
+            int next = n;
+            while (heap.size() > 1)
+            {
+                const Node a = heap.top(); heap.pop();
+                const Node b = heap.top(); heap.pop();
+                parent[a.second] = next;
+                parent[b.second] = next;
+                heap.push({a.first + b.first, next++});
+            }
+
+            int longest = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                int l = 0;
+                for (int p = i; parent[p] >= 0; p = parent[p]) ++l;
+                len[i] = l;
+                longest = std::max(longest, l);
+            }
+            if (longest <= max_code_len) return len;
+
+            // Flatten the distribution and try again.
+            for (auto& f : freq) f = (f+1)/2;
+        }
+    }
+
+    //
+    // Canonical codes: symbols ordered by (length, symbol) get consecutive
+    // codes.
+    //
+    std::vector<std::uint32_t> canonical_codes (const std::vector<std::uint32_t>& sym,
+                                                const std::vector<int>& len,
+                                                std::vector<int>& order)
+    {
+        const int n = static_cast<int>(sym.size());
+        order.resize(n);
+        for (int i = 0; i < n; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&] (int a, int b) {
+            return len[a] < len[b] || (len[a] == len[b] && sym[a] < sym[b]);
+        });
+
+        std::vector<std::uint32_t> code(n);
+        std::uint64_t c = 0;
+        int l = len[order[0]];
+        for (int i = 0; i < n; ++i)
+        {
+            const int o = order[i];
+            c <<= (len[o] - l);
+            l = len[o];
+            code[o] = static_cast<std::uint32_t>(c++);
+        }
+        return code;
+    }
+
+    struct BitWriter
+    {
+        std::vector<char>& out;
+        std::uint64_t acc = 0;
+        int nacc = 0;
+        std::uint64_t nbits = 0;
+
+        void write (std::uint32_t code, int len)
+        {
+            for (int b = len-1; b >= 0; --b)
+            {
+                acc = (acc << 1) | ((code >> b) & 1u);
+                if (++nacc == 8) {
+                    out.push_back(static_cast<char>(acc));
+                    acc = 0;
+                    nacc = 0;
+                }
+            }
+            nbits += len;
+        }
+
+        void flush ()
+        {
+            if (nacc > 0) {
+                out.push_back(static_cast<char>(acc << (8-nacc)));
+                acc = 0;
+                nacc = 0;
+            }
+        }
+    };
+
+    void compress_component (Array4<Real const> const& a, const Box& bx, int n, Real eb,
+                             std::vector<char>& out)
+    {
+        const Long npts = bx.numPts();
+        const auto lo = amrex::lbound(bx);
+        const auto hi = amrex::ubound(bx);
+
+        Real vmax = 0.0;
+        bool finite = true;
+        std::vector<Real> v;
+        v.reserve(npts);
+        for (int k = lo.z; k <= hi.z; ++k) {
+        for (int j = lo.y; j <= hi.y; ++j) {
+        for (int i = lo.x; i <= hi.x; ++i) {
+            const Real x = a(i,j,k,n);
+            finite = finite && std::isfinite(x);
+            vmax = std::max(vmax, std::abs(x));
+            v.push_back(x);
+        }}}
+
+        //
+        // Slightly under 2 eb, so that rounding of q*step stays within eb.
+        //
+        const Real step = 2.0*eb*(1.0 - 1.e-12);
+
+        if (eb <= 0.0 || !finite || vmax/step > max_quantum)
+        {
+            out.push_back(stored_exactly);
+            const char* p = reinterpret_cast<const char*>(v.data());
+            out.insert(out.end(), p, p + npts*sizeof(Real));
+            return;
+        }
+
+        std::vector<std::int64_t> q(npts);
+        for (Long p = 0; p < npts; ++p) {
+            q[p] = std::llround(v[p]/step);
+        }
+
+        const Dim3 len = amrex::length(bx);
+        const Lorenzo pred{len.x, len.y, len.z};
+        std::vector<std::uint32_t> s(npts);
+        std::vector<std::int64_t>  literals;
+        std::vector<std::uint64_t> count(escape+1, 0);
+        for (Long k = 0, p = 0; k < pred.nz; ++k) {
+        for (Long j = 0; j < pred.ny; ++j) {
+        for (Long i = 0; i < pred.nx; ++i, ++p) {
+            const std::int64_t r = q[p] - pred(q.data(), i, j, k);
+            if (r > -max_residual && r < max_residual) {
+                s[p] = zigzag(r);
+            } else {
+                s[p] = escape;
+                literals.push_back(r);
+            }
+            ++count[s[p]];
+        }}}
+
+        std::vector<std::uint32_t> sym;
+        std::vector<std::uint64_t> freq;
+        for (std::uint32_t i = 0; i <= escape; ++i) {
+            if (count[i] > 0) {
+                sym.push_back(i);
+                freq.push_back(count[i]);
+            }
+        }
+        const std::vector<int> len = huffman_lengths(freq);
+        std::vector<int> order;
+        const std::vector<std::uint32_t> code = canonical_codes(sym, len, order);
+
+        std::vector<std::uint32_t> code_of(escape+1, 0);
+        std::vector<int>           len_of (escape+1, 0);
+        for (std::size_t i = 0; i < sym.size(); ++i) {
+            code_of[sym[i]] = code[i];
+            len_of [sym[i]] = len[i];
+        }
+
+        out.push_back(quantized);
+        put(out, step);
+        put(out, static_cast<std::uint32_t>(sym.size()));
+        for (std::size_t i = 0; i < sym.size(); ++i) {
+            put(out, sym[i]);
+            put(out, static_cast<std::uint8_t>(len[i]));
+        }
+        put(out, static_cast<std::uint64_t>(literals.size()));
+        for (auto r : literals) put(out, r);
+
+        std::vector<char> bits;
+        BitWriter bw{bits};
+        for (Long p = 0; p < npts; ++p) {
+            bw.write(code_of[s[p]], len_of[s[p]]);
+        }
+        bw.flush();
+        put(out, bw.nbits);
+        out.insert(out.end(), bits.begin(), bits.end());
+    }
+
+    const char* decompress_component (const char* in, Array4<Real> const& a, const Box& bx, int n)
+    {
+        const Long npts = bx.numPts();
+        const auto lo = amrex::lbound(bx);
+        const auto hi = amrex::ubound(bx);
+
+        const char mode = *in++;
+        if (mode == stored_exactly)
+        {
+            for (int k = lo.z; k <= hi.z; ++k) {
+            for (int j = lo.y; j <= hi.y; ++j) {
+            for (int i = lo.x; i <= hi.x; ++i) {
+                a(i,j,k,n) = get<Real>(in);
+            }}}
+            return in;
+        }
+        AMREX_ALWAYS_ASSERT(mode == quantized);
+
+        const Real step = get<Real>(in);
+        const auto nsym = get<std::uint32_t>(in);
+        std::vector<std::uint32_t> sym(nsym);
+        std::vector<int>           len(nsym);
+        for (std::uint32_t i = 0; i < nsym; ++i) {
+            sym[i] = get<std::uint32_t>(in);
+            len[i] = get<std::uint8_t>(in);
+        }
+        const auto nlit = get<std::uint64_t>(in);
+        std::vector<std::int64_t> literals(nlit);
+        for (auto& r : literals) r = get<std::int64_t>(in);
+        const auto nbits = get<std::uint64_t>(in);
+
+        //
+        // Canonical decoding tables: for each length, the first code and
+        // the position of its symbol in the (length, symbol) order.
+        //
+        std::vector<int> order;
+        canonical_codes(sym, len, order);
+        std::vector<std::int64_t> first_code(max_code_len+2, 0), first_index(max_code_len+2, 0),
+                                  count(max_code_len+2, 0);
+        for (std::uint32_t i = 0; i < nsym; ++i) ++count[len[i]];
+        std::int64_t c = 0, idx = 0;
+        for (int l = 1; l <= max_code_len; ++l)
+        {
+            c = (c + count[l-1]) << 1;
+            first_code[l]  = c;
+            first_index[l] = idx;
+            idx += count[l];
+        }
+
+        const auto* bits = reinterpret_cast<const unsigned char*>(in);
+        std::uint64_t bitpos = 0;
+
+        std::vector<std::int64_t> q(npts);
+        const Dim3 len = amrex::length(bx);
+        const Lorenzo pred{len.x, len.y, len.z};
+        std::size_t ilit = 0;
+        for (Long k = 0, p = 0; k < pred.nz; ++k) {
+        for (Long j = 0; j < pred.ny; ++j) {
+        for (Long i = 0; i < pred.nx; ++i, ++p)
+        {
+            std::uint32_t s = sym[order[0]];
+            if (nsym > 1)
+            {
+                std::int64_t code = 0;
+                for (int l = 1; l <= max_code_len; ++l)
+                {
+                    code = (code << 1) | ((bits[bitpos/8] >> (7 - bitpos%8)) & 1);
+                    ++bitpos;
+                    if (code - first_code[l] < count[l]) {
+                        s = sym[order[first_index[l] + code - first_code[l]]];
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                ++bitpos;
+            }
+            const std::int64_t r = (s == escape) ? literals[ilit++] : unzigzag(s);
+            q[p] = pred(q.data(), i, j, k) + r;
+        }}}
+        AMREX_ALWAYS_ASSERT(bitpos == nbits);
+
+        for (int k = lo.z, p = 0; k <= hi.z; ++k) {
+        for (int j = lo.y; j <= hi.y; ++j) {
+        for (int i = lo.x; i <= hi.x; ++i, ++p) {
+            a(i,j,k,n) = Real(q[p])*step;
+        }}}
+
+        return in + (nbits+7)/8;
+    }
+}
+
+namespace plot_compress {
+
+void
+compress_fab (const FArrayBox& fab, const Box& bx, int ncomp,
+              const Vector<Real>& eb, std::vector<char>& out)
+{
+    auto const& a = fab.const_array();
+    std::vector<char> comp;
+    for (int n = 0; n < ncomp; ++n)
+    {
+        comp.clear();
+        compress_component(a, bx, n, eb[n], comp);
+        put(out, static_cast<std::uint64_t>(comp.size()));
+        out.insert(out.end(), comp.begin(), comp.end());
+    }
+}
+
+void
+decompress_fab (const char* in, std::size_t nbytes, FArrayBox& fab)
+{
+    const char* end = in + nbytes;
+    auto const& a = fab.array();
+    for (int n = 0; n < fab.nComp(); ++n)
+    {
+        const auto len = get<std::uint64_t>(in);
+        const char* next = decompress_component(in, a, fab.box(), n);
+        AMREX_ALWAYS_ASSERT(next == in + len && next <= end);
+        in = next;
+    }
+}
+
+void
+write_level (const MultiFab& mf, const Vector<std::string>& names,
+             const Vector<Real>& eb, const std::string& prefix)
+{
+    const int ncomp  = mf.nComp();
+    const int nboxes = mf.size();
+    const int nprocs = ParallelDescriptor::NProcs();
+    const int myproc = ParallelDescriptor::MyProc();
+
+    //
+    // Compress the local FABs.
+    //
+    const int nlocal = mf.local_size();
+    std::vector<std::vector<char>> blob(nlocal);
+#ifdef AMREX_USE_OMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int li = 0; li < nlocal; ++li)
+    {
+        const int gi = mf.IndexArray()[li];
+        compress_fab(mf[gi], mf.boxArray()[gi], ncomp, eb, blob[li]);
+    }
+
+    //
+    // Ranks myproc, myproc+nfiles, ... append to the same file in turn.
+    //
+    const int nfiles = std::max(1, std::min(nprocs, VisMF::GetNOutFiles()));
+    const int ifile  = myproc % nfiles;
+    const std::string fname = amrex::Concatenate(prefix + "_D_", ifile, 5);
+    const int tag = ParallelDescriptor::SeqNum();
+
+    Long offset = 0;
+    if (myproc >= nfiles) {
+        ParallelDescriptor::Recv(&offset, 1, myproc-nfiles, tag);
+    }
+
+    // File, offset and size of each box, summed over the ranks.
+    Vector<Long> index(3*nboxes, 0);
+    {
+        std::ofstream ofs(fname, myproc < nfiles ? std::ios::out|std::ios::trunc|std::ios::binary
+                                                 : std::ios::out|std::ios::app|std::ios::binary);
+        if (!ofs.good()) {
+            amrex::FileOpenFailed(fname);
+        }
+        for (int li = 0; li < nlocal; ++li)
+        {
+            const int gi = mf.IndexArray()[li];
+            index[3*gi  ] = ifile;
+            index[3*gi+1] = offset;
+            index[3*gi+2] = static_cast<Long>(blob[li].size());
+            ofs.write(blob[li].data(), blob[li].size());
+            offset += static_cast<Long>(blob[li].size());
+        }
+    }
+
+    if (myproc + nfiles < nprocs) {
+        ParallelDescriptor::Send(&offset, 1, myproc+nfiles, tag);
+    }
+
+    ParallelDescriptor::ReduceLongSum(index.dataPtr(), index.size(),
+                                      ParallelDescriptor::IOProcessorNumber());
+
+    if (ParallelDescriptor::IOProcessor())
+    {
+        const std::string hname = prefix + "_H";
+        std::ofstream ofs(hname, std::ios::out|std::ios::trunc);
+        if (!ofs.good()) {
+            amrex::FileOpenFailed(hname);
+        }
+        ofs.precision(17);
+        ofs << header_version << '\n' << ncomp << '\n';
+        for (int n = 0; n < ncomp; ++n) {
+            ofs << names[n] << ' ' << std::max(eb[n], Real(0.0)) << '\n';
+        }
+        ofs << nboxes << '\n';
+        for (int i = 0; i < nboxes; ++i)
+        {
+            ofs << mf.boxArray()[i] << ' ' << index[3*i] << ' '
+                << index[3*i+1] << ' ' << index[3*i+2] << '\n';
+        }
+    }
+    ParallelDescriptor::Barrier();
+}
+
+std::unique_ptr<MultiFab>
+read_level (const std::string& prefix, Vector<std::string>& names)
+{
+    const std::string hname = prefix + "_H";
+    Vector<char> fileCharPtr;
+    ParallelDescriptor::ReadAndBcastFile(hname, fileCharPtr);
+    std::istringstream is(fileCharPtr.dataPtr(), std::istringstream::in);
+
+    std::string version;
+    is >> version;
+    if (version != header_version) {
+        amrex::Abort("plot_compress::read_level(): " + hname + " is not a compressed level");
+    }
+
+    int ncomp;
+    is >> ncomp;
+    names.resize(ncomp);
+    for (int n = 0; n < ncomp; ++n)
+    {
+        Real eb;
+        is >> names[n] >> eb;
+    }
+
+    int nboxes;
+    is >> nboxes;
+    BoxList bl;
+    Vector<Long> index(3*nboxes);
+    for (int i = 0; i < nboxes; ++i)
+    {
+        Box b;
+        is >> b >> index[3*i] >> index[3*i+1] >> index[3*i+2];
+        bl.push_back(b);
+    }
+
+    const BoxArray ba(std::move(bl));
+    const DistributionMapping dm(ba);
+    auto mf = std::make_unique<MultiFab>(ba, dm, ncomp, 0,
+                                         MFInfo().SetArena(The_Pinned_Arena()));
+
+    std::vector<char> buf;
+    for (MFIter mfi(*mf); mfi.isValid(); ++mfi)
+    {
+        const int gi = mfi.index();
+        const std::string fname = amrex::Concatenate(prefix + "_D_", int(index[3*gi]), 5);
+        std::ifstream ifs(fname, std::ios::in|std::ios::binary);
+        if (!ifs.good()) {
+            amrex::FileOpenFailed(fname);
+        }
+        buf.resize(index[3*gi+2]);
+        ifs.seekg(index[3*gi+1]);
+        ifs.read(buf.data(), buf.size());
+        decompress_fab(buf.data(), buf.size(), (*mf)[mfi]);
+    }
+
+    return mf;
+}
+
+}
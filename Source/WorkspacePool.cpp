@@ -0,0 +1,82 @@
+#include <WorkspacePool.H>
+
+using namespace amrex;
+
+void
+WorkspacePool::define (const AmrLevel* amr_level)
+{
+    clear();
+    m_level = amr_level;
+}
+
+void
+WorkspacePool::clear ()
+{
+    AMREX_ASSERT(m_used.empty());
+    m_free.clear();
+    m_used.clear();
+    m_bytes_allocated = 0;
+    m_bytes_reused    = 0;
+}
+
+MultiFab*
+WorkspacePool::acquire (int dir, int ncomp, int ngrow)
+{
+    AMREX_ASSERT(m_level != nullptr);
+
+    for (int i = 0; i < m_free.size(); ++i)
+    {
+        if (m_free[i].dir == dir && m_free[i].ncomp == ncomp && m_free[i].ngrow == ngrow)
+        {
+            m_bytes_reused += m_free[i].bytes;
+            m_used.push_back(std::move(m_free[i]));
+            m_free.erase(m_free.begin()+i);
+            return m_used.back().mf.get();
+        }
+    }
+
+    const BoxArray& ba = (dir < 0) ? m_level->boxArray() : m_level->getEdgeBoxArray(dir);
+    auto mf = std::make_unique<MultiFab>(ba, m_level->DistributionMap(), ncomp, ngrow,
+                                         MFInfo(), m_level->Factory());
+    Long bytes = 0;
+    for (MFIter mfi(*mf); mfi.isValid(); ++mfi) {
+        bytes += (*mf)[mfi].nBytes();
+    }
+    m_bytes_allocated += bytes;
+
+    m_used.push_back({dir, ncomp, ngrow, bytes, std::move(mf)});
+    return m_used.back().mf.get();
+}
+
+void
+WorkspacePool::release (MultiFab* mf)
+{
+    for (int i = 0; i < m_used.size(); ++i)
+    {
+        if (m_used[i].mf.get() == mf)
+        {
+            m_free.push_back(std::move(m_used[i]));
+            m_used.erase(m_used.begin()+i);
+            return;
+        }
+    }
+    amrex::Abort("WorkspacePool::release(): MultiFab not from this pool");
+}
+
+void
+WorkspacePool::report (int level, bool print)
+{
+    if (print)
+    {
+        Long counts[2] = {m_bytes_allocated, m_bytes_reused};
+        ParallelDescriptor::ReduceLongSum(counts, 2, ParallelDescriptor::IOProcessorNumber());
+
+        amrex::Print() << "WorkspacePool: lev: " << level
+                       << ", bytes allocated: " << counts[0]
+                       << ", bytes reused: "    << counts[1]
+                       << ", buffers: "         << m_free.size() + m_used.size() << '\n';
+    }
+
+    m_bytes_allocated = 0;
+    m_bytes_reused    = 0;
+}
@@ -1,5 +1,6 @@
 
 #include <cstdio>
+#include <csignal>
 
 #include <AMReX_CArena.H>
 #include <AMReX_REAL.H>
@@ -8,6 +9,10 @@
 #include <AMReX_ParmParse.H>
 #include <AMReX_ParallelDescriptor.H>
 #include <AMReX_BLProfiler.H>
+#include <AMReX_FArrayBox.H>
+#include <NavierStokesBase.H>
+
+#include <fstream>
 
 #ifdef AMREX_USE_EB
 #include <AMReX_EB2.H>
@@ -23,10 +28,304 @@ void initialize_EB2 (const Geometry& geom, int required_level, int max_level);
 
 amrex::LevelBld* getLevelBld ();
 
+int  parareal_nslices (int argc, char* argv[]);
+void parareal_main (int argc, char* argv[], int nslices);
+
+namespace
+{
+    //
+    // Set by SIGTERM/SIGUSR1: finish the current coarse step, write a
+    // checkpoint and exit.
+    //
+    volatile std::sig_atomic_t stop_signal = 0;
+
+    extern "C" void request_stop (int sig)
+    {
+        stop_signal = sig;
+    }
+
+    //
+    // Wall-clock checkpoint schedule:
+    //
+    //   checkpoint_minutes     = 30     # checkpoint every 30 minutes of wall clock
+    //   walltime_limit_minutes = 720    # job length; checkpoint and stop before it
+    //   walltime_safety        = 1.2    # margin on the predicted step + checkpoint cost
+    //   catch_signals          = 0      # 1: checkpoint and stop on SIGTERM/SIGUSR1
+    //
+    //
+    // Grid decomposition tuning (tune_grids = 1): short runs of the problem
+    // for every combination of
+    //
+    //   tune_grids.max_grid_size   = 32 64 128
+    //   tune_grids.blocking_factor = 8 16 32
+    //   tune_grids.tile_size       = 1024 16 8     # cubic tiles; 1024 ~ no tiling
+    //   tune_grids.nsteps          = 4             # coarse steps, the first is not timed
+    //   tune_grids.output          = grid_tuning.inputs
+    //
+    // that satisfies the constraints below, then write the fastest as an
+    // inputs fragment.
+    //
+    std::string check_decomposition (int max_grid_size, int blocking_factor,
+                                     int tile_size, const Box& domain)
+    {
+        if (blocking_factor <= 0 || (blocking_factor & (blocking_factor-1)) != 0) {
+            return "blocking_factor is not a power of 2";
+        }
+        if (max_grid_size % blocking_factor != 0) {
+            return "max_grid_size is not a multiple of blocking_factor";
+        }
+        for (int d = 0; d < AMREX_SPACEDIM; ++d) {
+            if (domain.length(d) % blocking_factor != 0) {
+                return "amr.n_cell is not a multiple of blocking_factor";
+            }
+        }
+        // The nodal projection coarsens every grid at least twice
+        // before agglomerating.
+        if (blocking_factor < 4) {
+            return "blocking_factor < 4 stalls the nodal projection coarsening";
+        }
+#ifdef AMREX_USE_EB
+        // The NUM_GROW ghost cells of a fine grid must come from the
+        // neighboring grids or from one coarse grid.
+        if (blocking_factor < 2*NavierStokesBase::NUM_GROW) {
+            return "blocking_factor < 2*NUM_GROW with EB";
+        }
+#endif
+        if (tile_size <= 0) {
+            return "tile_size must be positive";
+        }
+        return std::string();
+    }
+
+    void tune_grid_decomposition (Real strt_time, Real stop_time, const Box& domain)
+    {
+        ParmParse pp("tune_grids");
+
+        Vector<int> mgs{32, 64, 128};
+        Vector<int> bf{8, 16, 32};
+        Vector<int> tiles{FabArrayBase::mfiter_tile_size[0]};
+        int nsteps = 4;
+        std::string output("grid_tuning.inputs");
+        pp.queryarr("max_grid_size", mgs);
+        pp.queryarr("blocking_factor", bf);
+        pp.queryarr("tile_size", tiles);
+        pp.query("nsteps", nsteps);
+        pp.query("output", output);
+        nsteps = std::max(nsteps, 2);
+
+        // No output during the trials. The NavierStokesBase parameters
+        // were read with the first Amr, so its diagnostics are suspended.
+        ParmParse ppamr("amr");
+        ppamr.add("plot_int", -1);
+        ppamr.add("check_int", -1);
+        ppamr.add("plot_per", -1.0);
+        ppamr.add("check_per", -1.0);
+        NavierStokesBase::suspendDiagnostics(true);
+
+        struct Trial { int mgs, bf, tile; Real step_time; Long bytes; };
+        Vector<Trial> trials;
+
+        for (int m : mgs) {
+        for (int b : bf) {
+        for (int t : tiles)
+        {
+            const std::string why = check_decomposition(m, b, t, domain);
+            if (!why.empty()) {
+                amrex::Print() << "tune_grids: skipping max_grid_size " << m << ", blocking_factor "
+                               << b << ", tile_size " << t << ": " << why << '\n';
+                continue;
+            }
+
+            ppamr.add("max_grid_size", m);
+            ppamr.add("blocking_factor", b);
+            FabArrayBase::mfiter_tile_size = IntVect(AMREX_D_DECL(t, t, t));
+
+            amrex::ResetTotalBytesAllocatedInFabsHWM();
+
+            auto amr = std::make_unique<Amr>(getLevelBld());
+            amr->init(strt_time, stop_time);
+
+            Real step_time = 0.0;
+            for (int step = 0; step < nsteps; ++step)
+            {
+                ParallelDescriptor::Barrier();
+                const Real strt = ParallelDescriptor::second();
+                amr->coarseTimeStep(stop_time);
+                if (step > 0) step_time += ParallelDescriptor::second() - strt;
+            }
+            step_time /= (nsteps-1);
+            ParallelDescriptor::ReduceRealMax(step_time);
+
+            Long bytes = amrex::TotalBytesAllocatedInFabsHWM();
+            ParallelDescriptor::ReduceLongMax(bytes);
+
+            amrex::Print() << "tune_grids: max_grid_size " << m << ", blocking_factor " << b
+                           << ", tile_size " << t << ": " << step_time << " s/step, "
+                           << bytes/(1024*1024) << " MB max per rank\n";
+
+            trials.push_back({m, b, t, step_time, bytes});
+        }}}
+
+        NavierStokesBase::suspendDiagnostics(false);
+
+        if (trials.empty()) {
+            amrex::Abort("tune_grids: no admissible decomposition among the candidates");
+        }
+
+        const auto best = std::min_element(trials.begin(), trials.end(),
+                              [] (const Trial& a, const Trial& b) { return a.step_time < b.step_time; });
+
+        if (ParallelDescriptor::IOProcessor())
+        {
+            std::ofstream ofs(output, std::ios::out|std::ios::trunc);
+            if (!ofs.good()) {
+                amrex::FileOpenFailed(output);
+            }
+            ofs << "# Tuned on " << ParallelDescriptor::NProcs() << " ranks for domain " << domain << '\n'
+                << "# max_grid_size blocking_factor tile_size s/step MB/rank\n";
+            for (const auto& tr : trials) {
+                ofs << "#   " << tr.mgs << ' ' << tr.bf << ' ' << tr.tile << ' '
+                    << tr.step_time << ' ' << tr.bytes/(1024*1024) << '\n';
+            }
+            ofs << "amr.max_grid_size = " << best->mgs << '\n'
+                << "amr.blocking_factor = " << best->bf << '\n'
+                << "fabarray.mfiter_tile_size = " << best->tile << ' ' << best->tile
+#if (AMREX_SPACEDIM == 3)
+                << ' ' << best->tile
+#endif
+                << '\n';
+        }
+
+        amrex::Print() << "tune_grids: recommended settings written to " << output << '\n';
+    }
+
+    struct RunController
+    {
+        Real check_interval = -1.0;  // Seconds.
+        Real walltime_limit = -1.0;  // Seconds since the start of the run.
+        Real safety         = 1.2;
+        Real last_check     = 0.0;
+        Real step_cost      = 0.0;   // Largest coarse step seen, in seconds.
+        Real check_cost     = 0.0;   // Last checkpoint, in seconds.
+        bool stopped        = false; // Stopped by a signal or the wall-clock limit.
+
+        void read (ParmParse& pp)
+        {
+            Real minutes = -1.0;
+            pp.query("checkpoint_minutes", minutes);
+            if (minutes > 0.0) check_interval = 60.0*minutes;
+
+            minutes = -1.0;
+            pp.query("walltime_limit_minutes", minutes);
+            if (minutes > 0.0) walltime_limit = 60.0*minutes;
+
+            pp.query("walltime_safety", safety);
+
+            int catch_signals = 0;
+            pp.query("catch_signals", catch_signals);
+            if (catch_signals) {
+                std::signal(SIGTERM, request_stop);
+                std::signal(SIGUSR1, request_stop);
+            }
+        }
+
+        void checkPoint (Amr* amrptr)
+        {
+            const Real strt = ParallelDescriptor::second();
+            amrptr->checkPoint();
+            Real cost = ParallelDescriptor::second() - strt;
+            ParallelDescriptor::ReduceRealMax(cost);
+            check_cost = cost;
+        }
+
+        //
+        // Called after each coarse step, on all ranks, with checkpointed
+        // set when Amr wrote a checkpoint (amr.check_int) during the step.
+        // Returns true when the run has to stop now; a checkpoint has then
+        // been written.
+        //
+        bool afterStep (Amr* amrptr, Real run_strt, Real step_time, bool checkpointed)
+        {
+            //
+            // A checkpoint written by Amr is timed on its own and not
+            // counted in the step.
+            //
+            Real chk = -1.0;
+            if (checkpointed) {
+                chk = NavierStokesBase::lastCheckPointTime();
+                step_time -= chk;
+            }
+
+            // Agree on the clock and on any signal received by some rank.
+            Real r[4] = { ParallelDescriptor::second() - run_strt, step_time, Real(stop_signal), chk };
+            ParallelDescriptor::ReduceRealMax(r, 4);
+            const Real elapsed = r[0];
+            step_cost = std::max(step_cost, r[1]);
+            if (r[3] >= 0.0) {
+                check_cost = r[3];
+            }
+
+            const bool signaled = r[2] > 0.0;
+            const bool out_of_time = walltime_limit > 0.0 &&
+                elapsed + safety*(step_cost + check_cost) >= walltime_limit;
+
+            if (signaled || out_of_time)
+            {
+                amrex::Print() << "Stopping at step " << amrptr->levelSteps(0) << ": "
+                               << (signaled ? "signal received" : "wall-clock limit approaching")
+                               << " (elapsed " << elapsed << " s)\n";
+                if (amrptr->stepOfLastCheckPoint() < amrptr->levelSteps(0)) {
+                    checkPoint(amrptr);
+                }
+                stopped = true;
+                return true;
+            }
+
+            if (check_interval > 0.0 && elapsed - last_check >= check_interval)
+            {
+                if (amrptr->stepOfLastCheckPoint() < amrptr->levelSteps(0)) {
+                    checkPoint(amrptr);
+                }
+                last_check = elapsed;
+            }
+            return false;
+        }
+
+        //
+        // Whether the final plotfile may still be written. After an early
+        // stop, it is budgeted like a checkpoint against the wall-clock
+        // limit, and skipped after a signal.
+        //
+        bool finalPlotFileFits (Real run_strt) const
+        {
+            if (!stopped) return true;
+
+            Real r[2] = { ParallelDescriptor::second() - run_strt, Real(stop_signal) };
+            ParallelDescriptor::ReduceRealMax(r, 2);
+            const bool fits = r[1] == 0.0 &&
+                (walltime_limit <= 0.0 || r[0] + safety*check_cost < walltime_limit);
+            if (!fits) {
+                amrex::Print() << "Skipping the final plotfile: no time left\n";
+            }
+            return fits;
+        }
+    };
+}
+
 int
 main (int   argc,
       char* argv[])
 {
+    //
+    // Parareal splits the ranks before AMReX starts (see NS_parareal.cpp).
+    //
+    const int parareal_slices = parareal_nslices(argc, argv);
+    if (parareal_slices > 1)
+    {
+        parareal_main(argc, argv, parareal_slices);
+        return 0;
+    }
+
     amrex::Initialize(argc,argv);
 
     BL_PROFILE_REGION_START("main()");
@@ -64,6 +363,32 @@ main (int   argc,
         amrex::Abort("Exiting because neither max_step nor stop_time is non-negative.");
     }
 
+    int parareal_inputs = 1;
+    pp.query("parareal.nslices", parareal_inputs);
+    if (parareal_inputs > 1)
+    {
+        amrex::Abort("parareal.nslices must be given on the command line");
+    }
+
+    RunController controller;
+    controller.read(pp);
+
+    //
+    // A delta checkpoint is expanded into a full one, which Amr restarts
+    // from instead (see NS_deltachk.cpp).
+    //
+    {
+        ParmParse ppamr("amr");
+        std::string chk;
+        ppamr.query("restart", chk);
+        const std::string full_chk = NavierStokesBase::expand_delta_checkpoint(chk);
+        if (full_chk != chk)
+        {
+            ppamr.remove("restart");
+            ppamr.add("restart", full_chk);
+        }
+    }
+
     Amr* amrptr = new Amr(getLevelBld());
     //    Amr amr;
 #ifdef AMREX_USE_EB
@@ -80,8 +405,29 @@ main (int   argc,
            max_coarsening_level);
 #endif
 
+    //
+    // Grid decomposition tuning replaces the run.
+    //
+    int tune_grids = 0;
+    pp.query("tune_grids", tune_grids);
+    if (tune_grids)
+    {
+        const Box domain = amrptr->Geom(0).Domain();
+        delete amrptr;
+        NavierStokesBase::remove_expanded_checkpoint();
+        tune_grid_decomposition(strt_time, stop_time, domain);
+
+        BL_PROFILE_VAR_STOP(pmain);
+        BL_PROFILE_REGION_STOP("main()");
+        BL_PROFILE_FINALIZE();
+        amrex::Finalize();
+        return 0;
+    }
+
     amrptr->init(strt_time,stop_time);
 
+    NavierStokesBase::remove_expanded_checkpoint();
+
     // This feature stop the simulation at a specfic time
     // after the physical time of the checkpoint file
     if (stop_interval > 0.) stop_time = amrptr->cumTime() + stop_interval;
@@ -120,7 +466,15 @@ main (int   argc,
            (amrptr->levelSteps(0) < max_step || max_step < 0) &&
            (amrptr->cumTime() < stop_time || stop_time < 0.0) )
     {
+        const Real step_strt = ParallelDescriptor::second();
+        const int  last_chk  = amrptr->stepOfLastCheckPoint();
+
         amrptr->coarseTimeStep(stop_time);
+
+        if (controller.afterStep(amrptr, run_strt, ParallelDescriptor::second() - step_strt,
+                                 amrptr->stepOfLastCheckPoint() != last_chk)) {
+            break;
+        }
     }
     //
     // Write final checkpoint and plotfile.
@@ -130,10 +484,16 @@ main (int   argc,
         amrptr->checkPoint();
     }
 
-    if (amrptr->stepOfLastPlotFile() < amrptr->levelSteps(0))
+    if (amrptr->stepOfLastPlotFile() < amrptr->levelSteps(0) &&
+        controller.finalPlotFileFits(run_strt))
     {
         amrptr->writePlotFile();
     }
+    //
+    // The probe samples left are written while the derived variables, and
+    // so the names of their components, are still known.
+    //
+    NavierStokesBase::flush_probes();
 
     delete amrptr;
 
@@ -1,14 +1,21 @@
 // ---------------------------------------------------------------
 // This tool reads a Checkpoint file, interpolate to a finer grid
-// and writes it out again.
+// (or average down to a coarser one) and writes it out again.
 // It is inspired from the Embiggening tool in the Castro distribution
 // Validated for IAMR 2D and multi-levels.
 // Please report bugs and problems to Emmanuel Motheau (emotheau@lbl.gov)
 // November 14 2020
+//
+// The conversion is streamed: only the checkpoint Header is held in
+// memory, and the MultiFabs are read, converted and written one level,
+// one state type and one time level at a time.  The target grids are
+// chopped to max_grid_size and distributed over all the ranks, so the
+// interpolation work and the I/O are shared by the whole job.
 // ---------------------------------------------------------------
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -19,6 +26,8 @@
 #include <AMReX_REAL.H>
 #include <AMReX_Box.H>
 #include <AMReX_FArrayBox.H>
+#include <AMReX_MultiFab.H>
+#include <AMReX_MultiFabUtil.H>
 #include <AMReX_ParmParse.H>
 #include <AMReX_ParallelDescriptor.H>
 #include <AMReX_DataServices.H>
@@ -58,31 +67,32 @@ int nFiles(64);
 bool verbose(true);
 int      user_ratio(1);
 int   max_grid_size(4096);
+int   finest_level_out(-1);
 const std::string CheckPointVersion = "CheckPointVersion_1.0";
-std::string interp_kind;
+std::string interp_kind("refine");
 
 Real avg_time;
 Real avg_time_fluct;
 bool TimeAverageFile_exist = false;
-int flag_eb = 0;
-
-Vector<int> nsets_save(1);
 
 VisMF::How how = VisMF::OneFilePerCPU;
 
 // ---------------------------------------------------------------
+//
+// Only the Header information is kept for the state data; the
+// MultiFabs themselves are streamed from disk when converted.
+//
 struct FakeStateData {
     struct TimeInterval {
         Real start, stop;
     };
-    const StateDescriptor *desc;
     Box domain;
     BoxArray grids;
     TimeInterval new_time;
     TimeInterval old_time;
-    MultiFab *new_data;
-    MultiFab *old_data;
-    Vector< Vector<BCRec> > bc;
+    int nsets;
+    std::string new_mf_name;          // Relative to the checkpoint directory.
+    std::string old_mf_name;
 };
 
 
@@ -93,7 +103,6 @@ struct FakeAmrLevel {
     IntVect crse_ratio;               // Refinement ratio to coarser level.
     IntVect fine_ratio;               // Refinement ratio to finer level.
     Vector<FakeStateData> state;       // Array of state data.
-    Vector<FakeStateData> new_state;   // Array of new state data.
 };
 
 
@@ -132,42 +141,55 @@ static void ScanArguments() {
     if(pp.contains("interp_kind")) {
       pp.get("interp_kind", interp_kind);
     }
-    if(pp.contains("flag_eb")) {
-      pp.get("flag_eb", flag_eb);
+    if(pp.contains("max_grid_size")) {
+      pp.get("max_grid_size", max_grid_size);
+    }
+    if(pp.contains("finest_level")) {
+      pp.get("finest_level", finest_level_out);
+    }
+    if(pp.contains("nfiles")) {
+      pp.get("nfiles", nFiles);
     }
-    if (user_ratio != 2 && user_ratio != 4)
-       amrex::Abort("user_ratio must be 2 or 4");
+    if (user_ratio != 1 && user_ratio != 2 && user_ratio != 4)
+       amrex::Abort("user_ratio must be 1, 2 or 4");
 
     if (interp_kind != "refine" && interp_kind != "coarsen" )
        amrex::Abort("interp_kind must be set to `refine` or `coarsen`");
 
+    if (max_grid_size <= 0)
+       amrex::Abort("max_grid_size must be positive");
+
 }
 
 // ---------------------------------------------------------------
 static void PrintUsage (char *progName) {
     cout << "Usage: " << progName << " checkin=filename "
          << "checkout=outfilename "
-         << "user_ratio= 2 or 4 "
+         << "user_ratio= 1, 2 or 4 "
          << "interp_kind= refine or coarsen "
+         << "[max_grid_size=n] "
+         << "[finest_level=n] "
+         << "[nfiles=n] "
          << "[verbose=trueorfalse]" << endl;
     exit(1);
 }
 
-static void ReadCheckpointFile(const std::string& fileName) {
+// ---------------------------------------------------------------
+//
+// Reads the checkpoint Header only.  The names of the state MultiFabs
+// are recorded so that they can be read one at a time later on.
+//
+static void ReadCheckpointHeader(const std::string& fileName) {
     int i;
     std::string File = fileName;
 
     File += '/';
     File += "Header";
 
-    VisMF::IO_Buffer io_buffer(VisMF::IO_Buffer_Size);
-
-    std::ifstream is;
-    is.rdbuf()->pubsetbuf(io_buffer.dataPtr(), io_buffer.size());
-    is.open(File.c_str(), std::ios::in);
-    if( ! is.good()) {
-        amrex::FileOpenFailed(File);
-    }
+    Vector<char> fileCharPtr;
+    ParallelDescriptor::ReadAndBcastFile(File, fileCharPtr);
+    std::string fileCharPtrString(fileCharPtr.dataPtr());
+    std::istringstream is(fileCharPtrString, std::istringstream::in);
 
     //
     // Read global data.
@@ -235,8 +257,6 @@ static void ReadCheckpointFile(const std::string& fileName) {
       is >> fakeAmr_src.level_count[i];
     }
 
-    int ndesc_save;
-
     // READ LEVEL DATA
     for(int lev(0); lev <= fakeAmr_src.finest_level; ++lev) {
 
@@ -271,18 +291,10 @@ static void ReadCheckpointFile(const std::string& fileName) {
 
       falRef.grids.readFrom(is);
 
-      int nstate;
-      is >> nstate;
-      int ndesc = nstate;
-
-      // This should be the same at all levels
-      ndesc_save = ndesc;
-
-      // ndesc depends on which descriptor so we store a value for each
-      if (lev == 1) nsets_save.resize(ndesc_save);
+      int ndesc;
+      is >> ndesc;
 
       falRef.state.resize(ndesc);
-      falRef.new_state.resize(ndesc);
 
       for(int ii = 0; ii < ndesc; ii++) {
         // ******* StateDescriptor::restart
@@ -294,43 +306,14 @@ static void ReadCheckpointFile(const std::string& fileName) {
         is >> falRef.state[ii].new_time.start;
         is >> falRef.state[ii].new_time.stop;
 
-        int nsets;
-        is >> nsets;
-
-        nsets_save[ii] = nsets;
-
-        falRef.state[ii].old_data = 0;
-        falRef.state[ii].new_data = 0;
-
-        std::string mf_name;
-        std::string FullPathName;
-
-        // This reads the "new" data, if it's there
-        if (nsets >= 1) {
-           falRef.state[ii].new_data = new MultiFab;
-           is >> mf_name;
-           // Note that mf_name is relative to the Header file.
-           // We need to prepend the name of the fileName directory.
-           FullPathName = fileName;
-           if( ! fileName.empty() && fileName[fileName.length()-1] != '/') {
-             FullPathName += '/';
-           }
-           FullPathName += mf_name;
-           VisMF::Read(*(falRef.state[ii].new_data), FullPathName);
-        }
+        is >> falRef.state[ii].nsets;
 
-        // This reads the "old" data, if it's there
-        if (nsets == 2) {
-          falRef.state[ii].old_data = new MultiFab;
-          is >> mf_name;
-          // Note that mf_name is relative to the Header file.
-          // We need to prepend the name of the fileName directory.
-          FullPathName = fileName;
-          if( ! fileName.empty() && fileName[fileName.length()-1] != '/') {
-            FullPathName += '/';
-      }
-          FullPathName += mf_name;
-          VisMF::Read(*(falRef.state[ii].old_data), FullPathName);
+        // Note that the MultiFab names are relative to the Header file.
+        if (falRef.state[ii].nsets >= 1) {
+           is >> falRef.state[ii].new_mf_name;
+        }
+        if (falRef.state[ii].nsets == 2) {
+           is >> falRef.state[ii].old_mf_name;
         }
       }
     }
@@ -358,6 +341,224 @@ static void ReadCheckpointFile(const std::string& fileName) {
 
 }
 
+// ---------------------------------------------------------------
+//
+// Builds the target hierarchy description from the source Header.
+// No state data is touched here.
+//
+static void ConvertHeader() {
+
+  if (finest_level_out < 0) {
+    finest_level_out = fakeAmr_src.finest_level;
+  }
+  if (finest_level_out > fakeAmr_src.finest_level) {
+    amrex::Abort("finest_level cannot exceed the finest level of the input checkpoint;"
+                 " new levels are created by regridding on restart");
+  }
+
+  const int nlev = finest_level_out + 1;
+
+  fakeAmr_trgt.cumtime      = fakeAmr_src.cumtime;
+  fakeAmr_trgt.finest_level = finest_level_out;
+  fakeAmr_trgt.geom.resize(nlev);
+  fakeAmr_trgt.ref_ratio.resize(finest_level_out);
+  fakeAmr_trgt.dt_level.resize(nlev);
+  fakeAmr_trgt.dt_min.resize(nlev);
+  fakeAmr_trgt.n_cycle.resize(nlev);
+  fakeAmr_trgt.level_steps.resize(nlev);
+  fakeAmr_trgt.level_count.resize(nlev);
+  fakeAmr_trgt.fakeAmrLevels.resize(nlev);
+
+  for (int lev = 0; lev < finest_level_out; lev++) {
+    fakeAmr_trgt.ref_ratio[lev] = fakeAmr_src.ref_ratio[lev];
+  }
+
+  for (int lev = 0; lev <= finest_level_out; lev++)
+  {
+    fakeAmr_trgt.n_cycle[lev]     = fakeAmr_src.n_cycle[lev];
+    fakeAmr_trgt.level_steps[lev] = fakeAmr_src.level_steps[lev];
+    fakeAmr_trgt.level_count[lev] = fakeAmr_src.level_count[lev];
+
+    FakeAmrLevel &falRef_src  = fakeAmr_src.fakeAmrLevels[lev];
+    FakeAmrLevel &falRef_trgt = fakeAmr_trgt.fakeAmrLevels[lev];
+
+// HERE WE REFINE (OR COARSEN) THE LEVEL DOMAIN
+    Box          domain_trgt(fakeAmr_src.geom[lev].Domain());
+    RealBox prob_domain_trgt(fakeAmr_src.geom[lev].ProbDomain());
+    int coord_trgt = fakeAmr_src.geom[lev].Coord();
+
+    BoxArray new_grids = falRef_src.grids;
+
+    if (interp_kind == "refine"){
+       domain_trgt.refine(user_ratio);
+       new_grids.refine(user_ratio);
+       fakeAmr_trgt.dt_level[lev] = fakeAmr_src.dt_level[lev] / user_ratio;
+       fakeAmr_trgt.dt_min[lev] = fakeAmr_src.dt_min[lev] / user_ratio;
+    } else {
+       if (!new_grids.coarsenable(user_ratio)) {
+         amrex::Abort("The grids of level " + std::to_string(lev) +
+                      " cannot be coarsened by user_ratio");
+       }
+       domain_trgt.coarsen(user_ratio);
+       new_grids.coarsen(user_ratio);
+       fakeAmr_trgt.dt_level[lev] = fakeAmr_src.dt_level[lev] * user_ratio;
+       fakeAmr_trgt.dt_min[lev] = fakeAmr_src.dt_min[lev] * user_ratio;
+    }
+
+    //
+    // Chop the target grids so that no box is larger than max_grid_size;
+    // this is what spreads the work over all the ranks.
+    //
+    new_grids.maxSize(max_grid_size);
+
+    const GpuArray<int,AMREX_SPACEDIM>& is_periodic_array = fakeAmr_src.geom[lev].isPeriodicArray();
+
+    fakeAmr_trgt.geom[lev].define(domain_trgt,&prob_domain_trgt,coord_trgt);
+    fakeAmr_trgt.geom[lev].setPeriodicity({{AMREX_D_DECL(is_periodic_array[0],is_periodic_array[1],is_periodic_array[2])}});
+
+    falRef_trgt.level      = lev;
+    falRef_trgt.geom       = fakeAmr_trgt.geom[lev];
+    falRef_trgt.grids      = new_grids;
+    falRef_trgt.crse_ratio = falRef_src.crse_ratio;
+    falRef_trgt.fine_ratio = falRef_src.fine_ratio;
+    falRef_trgt.state      = falRef_src.state;
+
+    for (int n = 0; n < falRef_trgt.state.size(); n++){
+      FakeStateData& sd = falRef_trgt.state[n];
+
+      if (interp_kind == "refine"){
+        sd.domain.refine(user_ratio);
+      } else {
+        sd.domain.coarsen(user_ratio);
+      }
+
+      //
+      // The state grids must match the level grids since AmrLevel::restart
+      // rebuilds the StateData on the level BoxArray.
+      //
+      sd.grids = new_grids;
+    }
+  }
+}
+
+// ---------------------------------------------------------------
+//
+// Extrapolate (zeroth order) into the cells of mf that lie outside the
+// non-periodic faces of the domain so that the interpolater stencils
+// only ever see data coming from the inside.
+//
+static void FillOutsideDomain(MultiFab& mf, const Geometry& geom) {
+
+    const Box dom = amrex::convert(geom.Domain(), mf.ixType());
+    const GpuArray<int,AMREX_SPACEDIM> is_periodic = geom.isPeriodicArray();
+    const int ncomp = mf.nComp();
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel
+#endif
+    for (MFIter mfi(mf); mfi.isValid(); ++mfi)
+    {
+      const Box& bx = mfi.fabbox();
+      if (dom.contains(bx)) continue;
+
+      Array4<Real> const& a = mf.array(mfi);
+
+      amrex::LoopOnCpu(bx, ncomp, [&] (int i, int j, int k, int n)
+      {
+        IntVect iv(AMREX_D_DECL(i,j,k));
+        IntVect ivc = iv;
+        for (int d = 0; d < AMREX_SPACEDIM; d++) {
+          if (!is_periodic[d]) {
+            ivc[d] = amrex::max(dom.smallEnd(d), amrex::min(dom.bigEnd(d), ivc[d]));
+          }
+        }
+        if (ivc != iv && bx.contains(ivc)) {
+          a(iv,n) = a(ivc,n);
+        }
+      });
+    }
+}
+
+// ---------------------------------------------------------------
+//
+// Reads one state MultiFab of level lev and converts it onto the target
+// grids.  The target is distributed over all the ranks; the source patches
+// needed by each target box are gathered with a ParallelCopy, so no rank
+// ever holds more than its share of the level.
+//
+static void ConvertMultiFab(const std::string& src_path, int lev, MultiFab& trgt) {
+
+    MultiFab src;
+    VisMF::Read(src, src_path);
+
+    const int ncomp        = src.nComp();
+    const IntVect ngrow    = src.nGrowVect();
+    const IndexType ixtype = src.ixType();
+
+    BoxArray ba = fakeAmr_trgt.fakeAmrLevels[lev].grids;
+    ba.convert(ixtype);
+    DistributionMapping dm{ba};
+
+    trgt.define(ba, dm, ncomp, ngrow);
+    trgt.setVal(0.);
+
+    const Geometry& src_geom  = fakeAmr_src.geom[lev];
+    const Geometry& trgt_geom = fakeAmr_trgt.geom[lev];
+
+    IntVect new_ratio(AMREX_D_DECL(user_ratio,user_ratio,user_ratio));
+    const IntVect& rr = new_ratio;
+
+    if (user_ratio == 1) {
+
+      trgt.ParallelCopy(src, 0, 0, ncomp, ngrow, ngrow, trgt_geom.periodicity());
+
+    } else if (interp_kind == "refine") {
+
+      Interpolater*  interpolater = &cell_cons_interp;
+      if (ixtype.nodeCentered()) interpolater = &node_bilinear_interp;
+
+      BoxList bl(ixtype);
+      for (int i = 0; i < ba.size(); i++) {
+        bl.push_back(interpolater->CoarseBox(ba[i], rr));
+      }
+      BoxArray cba(std::move(bl));
+
+      // Coarse patches live on the target distribution.
+      MultiFab crse(cba, dm, ncomp, 0);
+      crse.setVal(0.);
+      crse.ParallelCopy(src, 0, 0, ncomp, ngrow, IntVect(0), src_geom.periodicity());
+      FillOutsideDomain(crse, src_geom);
+
+      Vector<BCRec> bx_bcrec(ncomp);
+
+#ifdef AMREX_USE_OMP
+#pragma omp parallel
+#endif
+      for (MFIter mfi(trgt); mfi.isValid(); ++mfi)
+      {
+        FArrayBox& ffab = trgt[mfi];
+        const FArrayBox& cfab = crse[mfi];
+        const Box&  bx   = mfi.validbox();
+
+        interpolater->interp(cfab,0,ffab,0,ncomp,bx,rr,
+                             src_geom,trgt_geom,bx_bcrec,0,0,RunOn::Host);
+      }
+
+      trgt.FillBoundary(trgt_geom.periodicity());
+
+    } else {
+
+      if (ixtype.cellCentered()) {
+        amrex::average_down (src, trgt, 0, ncomp, new_ratio);
+      } else {
+        amrex::average_down_nodal (src, trgt, new_ratio);
+      }
+
+      trgt.FillBoundary(trgt_geom.periodicity());
+
+    }
+}
+
 // ---------------------------------------------------------------
 
 static void WriteCheckpointFile(const std::string& inFileName, const std::string &outFileName) {
@@ -387,7 +588,7 @@ static void WriteCheckpointFile(const std::string& inFileName, const std::string
 
     HeaderFile.rdbuf()->pubsetbuf(io_buffer.dataPtr(), io_buffer.size());
 
-    int old_prec(0), i, ndesc_save;
+    int old_prec(0), i;
 
     if(ParallelDescriptor::IOProcessor()) {
         // Only the IOProcessor() writes to the header file.
@@ -426,12 +627,18 @@ static void WriteCheckpointFile(const std::string& inFileName, const std::string
         HeaderFile << '\n';
     }
 
+    std::string inPath = inFileName;
+    if( ! inPath.empty() && inPath[inPath.length()-1] != '/') {
+      inPath += '/';
+    }
+
     for(int lev(0); lev <= fakeAmr_trgt.finest_level; ++lev) {
 
+      const Real strt_time = ParallelDescriptor::second();
+
       std::ostream &os = HeaderFile;
       FakeAmrLevel &falRef = fakeAmr_trgt.fakeAmrLevels[lev];
       int ndesc = falRef.state.size();
-      ndesc_save = ndesc;
 
       // Build directory to hold the MultiFabs in the StateData at this level.
       char buf[64];
@@ -467,8 +674,6 @@ static void WriteCheckpointFile(const std::string& inFileName, const std::string
         // The name is relative to the Header file containing this name.
         // It's the name that gets written into the Header.
         //
-        // There is only one MultiFab written out at each level in HyperCLaw.
-        //
         std::string PathNameInHeader = Level;
         sprintf(buf, "/SD_%d", i);
         PathNameInHeader += buf;
@@ -480,58 +685,56 @@ static void WriteCheckpointFile(const std::string& inFileName, const std::string
           const std::string name(PathNameInHeader);
           const std::string fullpathname(FullPathName);
 
-          bool dump_old(true);
-          if(dump_old == true && falRef.state[i].old_data == 0) {
-            dump_old = false;
-          }
+          const FakeStateData& sd = falRef.state[i];
 
           if(ParallelDescriptor::IOProcessor()) {
             // The relative name gets written to the Header file.
             std::string mf_name_old = name;
-        mf_name_old += OldSuffix;
+            mf_name_old += OldSuffix;
             std::string mf_name_new = name;
-        mf_name_new += NewSuffix;
-
+            mf_name_new += NewSuffix;
 
-            os << falRef.state[i].domain << '\n';
+            os << sd.domain << '\n';
 
-            falRef.state[i].grids.writeOn(os);
+            sd.grids.writeOn(os);
 
-            os << falRef.state[i].old_time.start << '\n'
-               << falRef.state[i].old_time.stop  << '\n'
-               << falRef.state[i].new_time.start << '\n'
-               << falRef.state[i].new_time.stop  << '\n';
+            os << sd.old_time.start << '\n'
+               << sd.old_time.stop  << '\n'
+               << sd.new_time.start << '\n'
+               << sd.new_time.stop  << '\n';
 
-            if (nsets_save[i] > 0) {
-               if(dump_old) {
-                 os << 2 << '\n' << mf_name_new << '\n' << mf_name_old << '\n';
-               } else {
-                 os << 1 << '\n' << mf_name_new << '\n';
-               }
+            if (sd.nsets == 2) {
+              os << 2 << '\n' << mf_name_new << '\n' << mf_name_old << '\n';
+            } else if (sd.nsets == 1) {
+              os << 1 << '\n' << mf_name_new << '\n';
             } else {
               os << 0 << '\n';
             }
 
           }
 
-          if (nsets_save[i] > 0) {
-             BL_ASSERT(falRef.state[i].new_data);
-             std::string mf_fullpath_new = fullpathname;
-             mf_fullpath_new += NewSuffix;
-             VisMF::Write(*(falRef.state[i].new_data),mf_fullpath_new,how);
+          //
+          // Convert and write one MultiFab at a time; each goes out of
+          // scope before the next one is read.
+          //
+          if (sd.nsets > 0) {
+            MultiFab mf;
+            ConvertMultiFab(inPath + sd.new_mf_name, lev, mf);
+            VisMF::Write(mf, fullpathname + NewSuffix, how);
           }
 
-          if (nsets_save[i] > 1) {
-            BL_ASSERT(dump_old);
-            BL_ASSERT(falRef.state[i].old_data);
-            std::string mf_fullpath_old = fullpathname;
-        mf_fullpath_old += OldSuffix;
-            VisMF::Write(*(falRef.state[i].old_data),mf_fullpath_old,how);
+          if (sd.nsets > 1) {
+            MultiFab mf;
+            ConvertMultiFab(inPath + sd.old_mf_name, lev, mf);
+            VisMF::Write(mf, fullpathname + OldSuffix, how);
           }
           // ++++++++++++
       }
       // ========================
 
+       Real run_time = ParallelDescriptor::second() - strt_time;
+       ParallelDescriptor::ReduceRealMax(run_time, ParallelDescriptor::IOProcessorNumber());
+
        if (ParallelDescriptor::IOProcessor()) {
           if (lev == 0) {
              std::cout << " " << std::endl;
@@ -541,6 +744,10 @@ static void WriteCheckpointFile(const std::string& inFileName, const std::string
           std::cout << "New checkpoint level    " << lev << std::endl;
           std::cout << " ... domain is       " << fakeAmr_trgt.geom[lev].Domain() << std::endl;
           std::cout << " ...     dx is       " << fakeAmr_trgt.geom[lev].CellSize()[0] << std::endl;
+          std::cout << " ...  grids are      " << falRef.grids.size() << std::endl;
+          if (verbose) {
+             std::cout << " ... converted in    " << run_time << " s" << std::endl;
+          }
           std::cout << "  " << std::endl;
        }
 
@@ -586,176 +793,6 @@ static void WriteCheckpointFile(const std::string& inFileName, const std::string
 
 }
 
-
-
-// ---------------------------------------------------------------
-static void ConvertData() {
-
-  fakeAmr_trgt = fakeAmr_src;
-
-  int mx_lev = fakeAmr_trgt.finest_level;
-
-  for (int lev = 0; lev <= mx_lev; lev++)
-  {
-    FakeAmrLevel &falRef_src = fakeAmr_src.fakeAmrLevels[lev];
-    Box bx = fakeAmr_src.geom[lev].Domain();
-    BoxArray ba = falRef_src.grids;
-    DistributionMapping dm{ba};
-
-// HERE WE REFINE THE LEVEL IN FINE STRUCTURE
-    Box          domain_trgt(fakeAmr_trgt.geom[lev].Domain());
-    RealBox prob_domain_trgt(fakeAmr_trgt.geom[lev].ProbDomain());
-    int coord_trgt = fakeAmr_trgt.geom[lev].Coord();
-
-    if (interp_kind == "refine"){
-       domain_trgt.refine(user_ratio);
-    } else {
-       domain_trgt.coarsen(user_ratio);
-    }
-
-    fakeAmr_trgt.geom[lev].define(domain_trgt,&prob_domain_trgt,coord_trgt);
-
-    if (interp_kind == "refine"){
-      fakeAmr_trgt.dt_level[lev] = fakeAmr_trgt.dt_level[lev] / user_ratio;
-      fakeAmr_trgt.dt_min[lev] = fakeAmr_trgt.dt_min[lev] / user_ratio;
-    } else {
-      fakeAmr_trgt.dt_level[lev] = fakeAmr_trgt.dt_level[lev] * user_ratio;
-      fakeAmr_trgt.dt_min[lev] = fakeAmr_trgt.dt_min[lev] * user_ratio;
-    }
-
-    const GpuArray<int,AMREX_SPACEDIM>& is_periodic_array = fakeAmr_src.geom[lev].isPeriodicArray();
-    fakeAmr_trgt.geom[lev].setPeriodicity({{AMREX_D_DECL(is_periodic_array[0],is_periodic_array[1],is_periodic_array[2])}});
-
-// NOW WE WORK ON DATA THAT ARE IN THE fine FakeAmrLevel structure
-    FakeAmrLevel &falRef_trgt = fakeAmr_trgt.fakeAmrLevels[lev];
-    BoxArray new_grids = falRef_trgt.grids;
-
-    if (interp_kind == "refine"){
-      new_grids.refine(user_ratio);
-    } else {
-      new_grids.coarsen(user_ratio);
-    }
-
-
-    falRef_trgt.grids = new_grids;
-    falRef_trgt.geom.define(domain_trgt,&prob_domain_trgt,coord_trgt);
-
-    falRef_trgt.geom.setPeriodicity({{AMREX_D_DECL(is_periodic_array[0],is_periodic_array[1],is_periodic_array[2])}});
-
-    DistributionMapping dm_trgt{new_grids};
-
-    int ngrow_loc;
-
-    for (int n = 0; n < falRef_src.state.size(); n++){
-
-      ngrow_loc = 1;
-
-      if (flag_eb){
-        if(n == 0 || n == 2) ngrow_loc = 4;
-        if(n == 1) ngrow_loc = 1;
-      }
-
-      // We don't have the same number of ghost-cells for each data type
-      // Warning, this should be adapted for EB
-      if (falRef_src.state.size() == 4 && n == falRef_src.state.size()-1){
-        ngrow_loc = 0; // For this case, we just have Average_Type and no Divu_Type and Dsdt_type
-      }
-      else if (falRef_src.state.size() == 5 && n == falRef_src.state.size()-1){
-        ngrow_loc = 0; // For this case, we have Divu_Type and Dsdt_type, no Average_Type
-      }
-      else if (falRef_src.state.size() == 6 && n >= falRef_src.state.size()-2){
-        ngrow_loc = 0; // Here we have both Average_Type and Divu and Dsdt types
-      }
-
-
-      // Assuming that OldState and NewState have the same number of components
-      int ncomps = (falRef_src.state[n].old_data)->nComp();
-
-      BoxArray new_grids_state = falRef_trgt.state[n].grids;
-      BoxArray save_grids_state = falRef_trgt.state[n].grids;
-
-      if (interp_kind == "refine"){
-        new_grids_state.refine(user_ratio);
-      } else {
-        new_grids_state.coarsen(user_ratio);
-      }
-
-      falRef_trgt.state[n].grids = new_grids_state;
-
-       if (interp_kind == "refine"){
-         falRef_trgt.state[n].domain.refine(user_ratio);
-       } else {
-         falRef_trgt.state[n].domain.coarsen(user_ratio);
-       }
-
-
-      MultiFab * NewData_src = new MultiFab(save_grids_state,dm,ncomps,ngrow_loc);
-      MultiFab * OldData_src = new MultiFab(save_grids_state,dm,ncomps,ngrow_loc);
-      NewData_src -> setVal(10.);
-      OldData_src -> setVal(10.);
-
-      NewData_src -> copy(*(falRef_src.state[n].new_data),0,0,ncomps,0,ngrow_loc);
-      OldData_src -> copy(*(falRef_src.state[n].old_data),0,0,ncomps,0,ngrow_loc);
-
-      MultiFab * NewData_trgt = new MultiFab(new_grids_state,dm_trgt,ncomps,ngrow_loc);
-      MultiFab * OldData_trgt = new MultiFab(new_grids_state,dm_trgt,ncomps,ngrow_loc);
-      NewData_trgt->setVal(10.);
-      OldData_trgt->setVal(10.);
-
-      IntVect new_ratio(AMREX_D_DECL(user_ratio,user_ratio,user_ratio));
-      const IntVect& rr = new_ratio;
-
-      if (interp_kind == "refine"){
-
-        Interpolater*  interpolater = &cell_cons_interp;
-        if ( n == 1)  interpolater = &node_bilinear_interp;
-
-        const Geometry& fgeom = falRef_trgt.geom;
-        const Geometry& cgeom = falRef_src.geom;
-
-        for (MFIter mfi(*NewData_trgt); mfi.isValid(); ++mfi)
-        {
-          FArrayBox& ffab = (*NewData_trgt)[mfi];
-          const FArrayBox& cfab = (*NewData_src)[mfi];
-          const Box&  bx   = mfi.tilebox();
-          Vector<BCRec> bx_bcrec(ncomps);
-
-          interpolater->interp(cfab,0,ffab,0,ncomps,bx,rr,
-                               cgeom,fgeom,bx_bcrec,0,0,RunOn::Host);
-        }
-
-        for (MFIter mfi(*OldData_trgt); mfi.isValid(); ++mfi)
-        {
-          FArrayBox& ffab = (*OldData_trgt)[mfi];
-          const FArrayBox& cfab = (*OldData_src)[mfi];
-          const Box&  bx   = mfi.tilebox();
-          Vector<BCRec> bx_bcrec(ncomps);
-
-          interpolater->interp(cfab,0,ffab,0,ncomps,bx,rr,
-                               cgeom,fgeom,bx_bcrec,0,0,RunOn::Host);
-
-        }
-
-        NewData_trgt->FillBoundary(fgeom.periodicity());
-        OldData_trgt->FillBoundary(fgeom.periodicity());
-
-      } else {
-
-        amrex::average_down (*NewData_src, *NewData_trgt,
-                             0,  ncomps, new_ratio);
-
-        amrex::average_down (*OldData_src, *OldData_trgt,
-                             0,  ncomps, new_ratio);
-
-      }
-
-      falRef_trgt.state[n].new_data = NewData_trgt;
-      falRef_trgt.state[n].old_data = OldData_trgt;
-
-    }
-  }
-}
-
 // ---------------------------------------------------------------
 int main(int argc, char *argv[]) {
     amrex::Initialize(argc,argv);
@@ -772,13 +809,13 @@ int main(int argc, char *argv[]) {
       cout << " " << std::endl;
     }
 
-    // Read in the original checkpoint directory
-    ReadCheckpointFile(CheckFileIn);
+    // Read the Header of the original checkpoint directory
+    ReadCheckpointHeader(CheckFileIn);
 
-    // Interpolate to a finest grid
-    ConvertData();
+    // Build the target hierarchy
+    ConvertHeader();
 
-    // Write out the new checkpoint directory
+    // Stream the state data through the interpolation into the new checkpoint directory
     WriteCheckpointFile(CheckFileIn, CheckFileOut);
 
     if(verbose && ParallelDescriptor::IOProcessor()) {
@@ -0,0 +1,171 @@
+// ---------------------------------------------------------------
+// This tool checks the round trip of the plotfile compression of
+// Source/Utilities/PlotCompress.H: a level is written with
+// plot_compress::write_level and read back with
+// plot_compress::read_level, and every value must be within its
+// error bound. It is run by the regression suite (Test/IAMR-tests.ini)
+// and prints "PlotCompress round trip PASSED" on success.
+//
+// The level has one variable for each case of the codec:
+//
+//   abs      smooth data, absolute bound
+//   rel      smooth data, bound relative to the range on the level,
+//            computed as NavierStokesBase::write_compressed_level does
+//   none     noise, stored exactly (bound 0)
+//   escape   jumps of many bounds between cells, whose residuals are
+//            too large for the code table and stored as literals
+//   nonfinite  smooth data with a NaN in each grid, stored exactly
+// ---------------------------------------------------------------
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <AMReX.H>
+#include <AMReX_MultiFab.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Random.H>
+#include <AMReX_Utility.H>
+
+#include <PlotCompress.H>
+
+using namespace amrex;
+
+namespace
+{
+    int n_cell(64);
+    int max_grid_size(16);
+    std::string dir("plt_compress_check");
+    Real abs_bound(1.e-6);
+    Real rel_bound(1.e-4);
+
+    enum { c_abs = 0, c_rel, c_none, c_escape, c_nonfinite, ncomp };
+}
+
+// ---------------------------------------------------------------
+static void ScanArguments () {
+    ParmParse pp("check");
+
+    pp.query("n_cell",        n_cell);
+    pp.query("max_grid_size", max_grid_size);
+    pp.query("dir",           dir);
+    pp.query("abs_bound",     abs_bound);
+    pp.query("rel_bound",     rel_bound);
+}
+
+// ---------------------------------------------------------------
+static void FillLevel (MultiFab& mf) {
+    const Real h = 1.0/n_cell;
+    for (MFIter mfi(mf); mfi.isValid(); ++mfi)
+    {
+        const Box& bx = mfi.validbox();
+        auto const& a = mf[mfi].array();
+        const auto lo = amrex::lbound(bx);
+        const auto hi = amrex::ubound(bx);
+        for (int k = lo.z; k <= hi.z; ++k) {
+        for (int j = lo.y; j <= hi.y; ++j) {
+        for (int i = lo.x; i <= hi.x; ++i) {
+            const Real x = (i+0.5)*h, y = (j+0.5)*h;
+            const Real f = std::sin(2.0*M_PI*x)*std::cos(2.0*M_PI*y);
+            a(i,j,k,c_abs)       = f;
+            a(i,j,k,c_rel)       = 100.0 + 50.0*f;
+            a(i,j,k,c_none)      = amrex::Random();
+            a(i,j,k,c_escape)    = ((i+j+k) % 2 == 0) ? 1.0 : -1.0;
+            a(i,j,k,c_nonfinite) = f;
+        }}}
+        a(lo.x,lo.y,lo.z,c_nonfinite) = std::numeric_limits<Real>::quiet_NaN();
+    }
+}
+
+// ---------------------------------------------------------------
+int main (int argc, char* argv[]) {
+    amrex::Initialize(argc, argv);
+    {
+        ScanArguments();
+
+        const Box domain(IntVect(0), IntVect(n_cell-1));
+        BoxArray ba(domain);
+        ba.maxSize(max_grid_size);
+        const DistributionMapping dm(ba);
+
+        MultiFab mf(ba, dm, ncomp, 0, MFInfo().SetArena(The_Pinned_Arena()));
+        FillLevel(mf);
+
+        const Vector<std::string> names{"abs", "rel", "none", "escape", "nonfinite"};
+
+        Vector<Real> eb(ncomp, 0.0);
+        eb[c_abs]    = abs_bound;
+        eb[c_rel]    = rel_bound*(mf.max(c_rel) - mf.min(c_rel));
+        eb[c_escape] = abs_bound;
+
+        if (ParallelDescriptor::IOProcessor()) {
+            if (!amrex::UtilCreateDirectory(dir, 0755)) {
+                amrex::CreateDirectoryFailed(dir);
+            }
+        }
+        ParallelDescriptor::Barrier();
+
+        plot_compress::write_level(mf, names, eb, dir + "/CellZ");
+
+        Vector<std::string> names_read;
+        auto mf_read = plot_compress::read_level(dir + "/CellZ", names_read);
+
+        if (names_read != names) {
+            amrex::Abort("PlotCompressCheck: the variable names were not read back");
+        }
+        if (mf_read->boxArray() != ba) {
+            amrex::Abort("PlotCompressCheck: the grids were not read back");
+        }
+
+        //
+        // The original data on the layout of the data read.
+        //
+        MultiFab orig(mf_read->boxArray(), mf_read->DistributionMap(), ncomp, 0,
+                      MFInfo().SetArena(The_Pinned_Arena()));
+        orig.ParallelCopy(mf);
+
+        Vector<Real> err(ncomp, 0.0);
+        for (MFIter mfi(orig); mfi.isValid(); ++mfi)
+        {
+            const Box& bx = mfi.validbox();
+            auto const& a = orig[mfi].const_array();
+            auto const& b = (*mf_read)[mfi].const_array();
+            const auto lo = amrex::lbound(bx);
+            const auto hi = amrex::ubound(bx);
+            for (int n = 0; n < ncomp; ++n) {
+            for (int k = lo.z; k <= hi.z; ++k) {
+            for (int j = lo.y; j <= hi.y; ++j) {
+            for (int i = lo.x; i <= hi.x; ++i) {
+                const Real u = a(i,j,k,n), v = b(i,j,k,n);
+                //
+                // A NaN must come back as a NaN; exact data bit for bit.
+                //
+                Real e;
+                if (std::isnan(u) || std::isnan(v)) {
+                    e = (std::isnan(u) && std::isnan(v)) ? 0.0 : std::numeric_limits<Real>::max();
+                } else {
+                    e = std::abs(u - v);
+                }
+                err[n] = std::max(err[n], e);
+            }}}}
+        }
+        ParallelDescriptor::ReduceRealMax(err.dataPtr(), err.size());
+
+        bool passed = true;
+        for (int n = 0; n < ncomp; ++n)
+        {
+            const bool ok = err[n] <= eb[n];
+            passed = passed && ok;
+            amrex::Print() << "  " << names[n] << ": bound " << eb[n]
+                           << ", max error " << err[n] << (ok ? "" : "  FAILED") << '\n';
+        }
+
+        if (!passed) {
+            amrex::Abort("PlotCompress round trip FAILED");
+        }
+        amrex::Print() << "PlotCompress round trip PASSED\n";
+    }
+    amrex::Finalize();
+    return 0;
+}
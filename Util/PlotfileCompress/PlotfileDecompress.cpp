@@ -0,0 +1,151 @@
+// ---------------------------------------------------------------
+// This tool reads a plotfile written with plot_compress.enable = 1
+// and writes it out again as a regular plotfile, readable by any
+// AMReX plotfile tool.
+//
+// The levels are decompressed one at a time and written with VisMF;
+// the Header is copied, with the level data renamed from
+// Level_n/CellZ to Level_n/Cell. The job_info file is copied as well.
+// The data are the compressed ones: the error bounds used when writing
+// are recorded in Level_n/CellZ_H.
+// ---------------------------------------------------------------
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <AMReX.H>
+#include <AMReX_MultiFab.H>
+#include <AMReX_ParmParse.H>
+#include <AMReX_ParallelDescriptor.H>
+#include <AMReX_Utility.H>
+#include <AMReX_VisMF.H>
+
+#include <PlotCompress.H>
+
+using namespace amrex;
+
+namespace
+{
+    std::string infile;
+    std::string outfile;
+    int nfiles(64);
+    bool verbose(true);
+
+    const std::string compressed_suffix("/CellZ");
+}
+
+// ---------------------------------------------------------------
+static void PrintUsage (const char* progName) {
+    std::cout << "Usage: " << progName << " infile=plotfile "
+              << "outfile=outplotfile "
+              << "[nfiles=n] "
+              << "[verbose=trueorfalse]" << std::endl;
+    exit(1);
+}
+
+// ---------------------------------------------------------------
+static void ScanArguments () {
+    ParmParse pp;
+
+    pp.query("infile",  infile);
+    pp.query("outfile", outfile);
+    pp.query("nfiles",  nfiles);
+    pp.query("verbose", verbose);
+}
+
+// ---------------------------------------------------------------
+static void CopyFile (const std::string& from, const std::string& to) {
+    std::ifstream ifs(from, std::ios::in|std::ios::binary);
+    if (!ifs.good()) return;
+    std::ofstream ofs(to, std::ios::out|std::ios::trunc|std::ios::binary);
+    if (!ofs.good()) {
+        amrex::FileOpenFailed(to);
+    }
+    ofs << ifs.rdbuf();
+}
+
+// ---------------------------------------------------------------
+int main (int argc, char* argv[]) {
+    amrex::Initialize(argc, argv);
+    {
+        if (argc == 1) {
+            PrintUsage(argv[0]);
+        }
+
+        ScanArguments();
+
+        if (infile.empty() || outfile.empty()) {
+            PrintUsage(argv[0]);
+        }
+
+        VisMF::SetNOutFiles(nfiles);
+
+        Vector<char> fileCharPtr;
+        ParallelDescriptor::ReadAndBcastFile(infile + "/Header", fileCharPtr);
+        std::istringstream is(fileCharPtr.dataPtr(), std::istringstream::in);
+
+        if (ParallelDescriptor::IOProcessor()) {
+            if (!amrex::UtilCreateDirectory(outfile, 0755)) {
+                amrex::CreateDirectoryFailed(outfile);
+            }
+        }
+        ParallelDescriptor::Barrier();
+
+        //
+        // Every Level_n/CellZ line of the Header names a compressed level.
+        //
+        std::ostringstream header;
+        std::string line;
+        int nlevels = 0;
+        while (std::getline(is, line))
+        {
+            const auto pos = line.size() > compressed_suffix.size()
+                ? line.size() - compressed_suffix.size() : std::string::npos;
+            if (line.compare(0, 6, "Level_") != 0 || pos == std::string::npos ||
+                line.compare(pos, std::string::npos, compressed_suffix) != 0)
+            {
+                header << line << '\n';
+                continue;
+            }
+
+            const std::string sLevel = line.substr(0, pos);
+            const std::string outLevel = outfile + "/" + sLevel;
+            if (ParallelDescriptor::IOProcessor()) {
+                if (!amrex::UtilCreateDirectory(outLevel, 0755)) {
+                    amrex::CreateDirectoryFailed(outLevel);
+                }
+            }
+            ParallelDescriptor::Barrier();
+
+            Vector<std::string> names;
+            auto mf = plot_compress::read_level(infile + "/" + line, names);
+            VisMF::Write(*mf, outLevel + "/Cell");
+
+            if (verbose) {
+                amrex::Print() << "Decompressed " << sLevel << ": "
+                               << mf->size() << " grids, "
+                               << names.size() << " variables\n";
+            }
+
+            header << sLevel << "/Cell\n";
+            ++nlevels;
+        }
+
+        if (nlevels == 0) {
+            amrex::Abort(infile + " has no compressed levels");
+        }
+
+        if (ParallelDescriptor::IOProcessor())
+        {
+            std::ofstream ofs(outfile + "/Header", std::ios::out|std::ios::trunc);
+            if (!ofs.good()) {
+                amrex::FileOpenFailed(outfile + "/Header");
+            }
+            ofs << header.str();
+            CopyFile(infile + "/job_info", outfile + "/job_info");
+        }
+    }
+    amrex::Finalize();
+    return 0;
+}